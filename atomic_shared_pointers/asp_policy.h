@@ -0,0 +1,76 @@
+// Pointer policies : let a data structure pick which shared pointer / atomic shared pointer pair
+// manages its nodes, so the same algorithm can run on any of the implementations here.
+
+// A policy provides :
+//   node_base<U>                  base class of every node U (CRTP), empty unless the count lives in the node
+//   shared<U>                     shared pointer to U (copyable, get / -> / bool / ==)
+//   atomic_shared<U>              atomic holder of shared<U> with load, store and
+//                                 compare_exchange_weak / _strong(shared<U> &expected, shared<U> desired)
+//   make<U>(args...)              creates a shared<U>
+//   allocate<U>(alloc, args...)   same, with an allocator where the policy supports one
+//   guard                         RAII type held around every operation that dereferences nodes
+//   retire(shared<U>)             called once a node has been unlinked by the operation that unlinked it
+// For the reference counted policies node_base, guard and retire do nothing (refcounting_policy below),
+// the last reference frees a node. Deferred reclamation without reference counts (EBR) needs guard
+// and retire.
+
+// std_policy lives here, the others next to their implementations :
+//   asp::split_ref_cnt_policy          split_ref_cnt.h
+//   asp::packed_split_ref_cnt_policy   packed_split_ref_cnt.h
+//   asp::hazard_ptr_policy             hazard_ptr_asp.h
+//   asp::intrusive_policy              intrusive_ptr.h
+//   ebr::ebr_policy                    epoch_based_reclamation.h
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace asp
+{
+    template <typename Alloc>
+    struct is_std_allocator : std::false_type
+    {
+    };
+    template <typename U>
+    struct is_std_allocator<std::allocator<U>> : std::true_type
+    {
+    };
+    template <typename Alloc>
+    inline constexpr bool is_std_allocator_v = is_std_allocator<Alloc>::value;
+
+    struct refcounting_policy
+    {
+        template <typename U>
+        struct node_base
+        {
+        };
+        struct guard
+        {
+        };
+        template <typename S>
+        static void retire(const S &) {}
+    };
+
+    // C++20 std::atomic<std::shared_ptr>, not lock-free in current standard libraries
+    struct std_policy : refcounting_policy
+    {
+        template <typename U>
+        using shared = std::shared_ptr<U>;
+        template <typename U>
+        using atomic_shared = std::atomic<std::shared_ptr<U>>;
+
+        template <typename U, typename... Args>
+        static shared<U> make(Args &&...args)
+        {
+            return std::make_shared<U>(std::forward<Args>(args)...);
+        }
+        template <typename U, typename Alloc, typename... Args>
+        static shared<U> allocate(const Alloc &alloc, Args &&...args)
+        {
+            return std::allocate_shared<U>(alloc, std::forward<Args>(args)...);
+        }
+    };
+}
@@ -0,0 +1,230 @@
+// Opt-in contention counters for the lock-free structures : build with -DLF_CONTENTION_STATS.
+// Without it every hook below is an empty inline function on an empty object, ie no code at all.
+
+// Each instrumented operation opens an op_scope on its call site and routes every CAS it issues
+// through op.cas(...) (which just returns the CAS result), tail swings and other fix ups included,
+// and calls op.help() whenever it has to fix up someone else's half-done work (eg swing a lagging
+// tail). When the scope ends, the op is counted along with its CAS attempts / failures, and its
+// no of failed CASes lands in a retry histogram.
+
+// Counters are per thread (plain relaxed loads / stores, no RMW, no sharing), registered in a
+// global list. collect() sums all live threads plus whatever exited threads left behind, dump()
+// prints that. Counts from threads running meanwhile may be off by their ops in flight.
+
+// New call sites : add to `site` and `site_names`.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#ifdef LF_CONTENTION_STATS
+#include <atomic>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace contention
+{
+    enum class site : std::size_t
+    {
+        stack_push,
+        stack_pop,
+        queue_enqueue,
+        queue_dequeue,
+        queue_enqueue_bulk,
+        queue_dequeue_bulk,
+        asp_increment_if_nonzero, // hazard_ptr_asp.h, loading a pointer whose count may drop to 0
+        count
+    };
+    constexpr std::size_t site_count = static_cast<std::size_t>(site::count);
+    constexpr const char *site_names[site_count] = {
+        "stack push", "stack pop", "queue enqueue", "queue dequeue",
+        "queue enqueue_bulk", "queue dequeue_bulk", "asp increment_if_nonzero"};
+
+    // retries (failed CASes) per op : 0, 1, 2, 3-4, 5-8, 9-16, 17-32, more
+    constexpr std::size_t hist_buckets = 8;
+    constexpr const char *hist_labels[hist_buckets] = {"0", "1", "2", "3-4", "5-8", "9-16", "17-32", "33+"};
+    constexpr std::size_t hist_bucket(std::uint64_t retries)
+    {
+        return retries == 0 ? 0 : std::min<std::size_t>(hist_buckets - 1, 1 + std::bit_width(retries - 1));
+    }
+
+    struct site_stats
+    {
+        std::uint64_t ops{}, cas_attempts{}, cas_failures{}, helps{};
+        std::array<std::uint64_t, hist_buckets> retries{};
+    };
+    using snapshot = std::array<site_stats, site_count>;
+
+#ifdef LF_CONTENTION_STATS
+    constexpr bool enabled = true;
+
+    namespace detail
+    {
+        constexpr std::size_t fields = 4 + hist_buckets; // ops, attempts, failures, helps, histogram
+
+        struct thread_counters
+        {
+            std::atomic<std::uint64_t> v[site_count][fields]{};
+
+            // owner thread only : nobody else writes, so no RMW needed
+            void add(std::size_t s, std::size_t f, std::uint64_t n)
+            {
+                v[s][f].store(v[s][f].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            }
+        };
+
+        struct registry
+        {
+            std::mutex m;
+            std::vector<thread_counters *> live;
+            std::uint64_t exited[site_count][fields]{}; // left behind by threads that exited
+        };
+        inline registry &reg()
+        {
+            static auto r = new registry; // never destroyed, threads may exit after static destructors
+            return *r;
+        }
+
+        struct thread_handle
+        {
+            thread_counters c;
+            thread_handle()
+            {
+                std::lock_guard lk{reg().m};
+                reg().live.push_back(&c);
+            }
+            ~thread_handle()
+            {
+                auto &r = reg();
+                std::lock_guard lk{r.m};
+                for (std::size_t s = 0; s < site_count; ++s)
+                    for (std::size_t f = 0; f < fields; ++f)
+                        r.exited[s][f] += c.v[s][f].load(std::memory_order_relaxed);
+                r.live.erase(std::find(r.live.begin(), r.live.end(), &c));
+            }
+        };
+        inline thread_counters &local()
+        {
+            thread_local thread_handle h;
+            return h.c;
+        }
+    }
+
+    class op_scope
+    {
+        site s;
+        std::uint64_t attempts{}, failures{}, helps{};
+
+    public:
+        explicit op_scope(site s_) : s{s_} {}
+        op_scope(const op_scope &) = delete;
+        op_scope &operator=(const op_scope &) = delete;
+        ~op_scope()
+        {
+            auto &c = detail::local();
+            auto i = static_cast<std::size_t>(s);
+            c.add(i, 0, 1);
+            c.add(i, 1, attempts);
+            c.add(i, 2, failures);
+            c.add(i, 3, helps);
+            c.add(i, 4 + hist_bucket(failures), 1);
+        }
+        bool cas(bool succeeded)
+        {
+            ++attempts;
+            failures += !succeeded;
+            return succeeded;
+        }
+        void help() { ++helps; }
+    };
+
+    inline snapshot collect()
+    {
+        std::uint64_t sum[site_count][detail::fields]{};
+        auto &r = detail::reg();
+        {
+            std::lock_guard lk{r.m};
+            for (std::size_t s = 0; s < site_count; ++s)
+                for (std::size_t f = 0; f < detail::fields; ++f)
+                {
+                    sum[s][f] = r.exited[s][f];
+                    for (auto c : r.live)
+                        sum[s][f] += c->v[s][f].load(std::memory_order_relaxed);
+                }
+        }
+        snapshot out{};
+        for (std::size_t s = 0; s < site_count; ++s)
+        {
+            out[s].ops = sum[s][0];
+            out[s].cas_attempts = sum[s][1];
+            out[s].cas_failures = sum[s][2];
+            out[s].helps = sum[s][3];
+            for (std::size_t b = 0; b < hist_buckets; ++b)
+                out[s].retries[b] = sum[s][4 + b];
+        }
+        return out;
+    }
+
+    // Zeroes all counters, best done while no instrumented op runs (each thread owns its counters)
+    inline void reset()
+    {
+        auto &r = detail::reg();
+        std::lock_guard lk{r.m};
+        for (std::size_t s = 0; s < site_count; ++s)
+            for (std::size_t f = 0; f < detail::fields; ++f)
+            {
+                r.exited[s][f] = 0;
+                for (auto c : r.live)
+                    c->v[s][f].store(0, std::memory_order_relaxed);
+            }
+    }
+#else
+    constexpr bool enabled = false;
+
+    class op_scope
+    {
+    public:
+        explicit op_scope(site) {}
+        op_scope(const op_scope &) = delete;
+        op_scope &operator=(const op_scope &) = delete;
+        bool cas(bool succeeded) { return succeeded; }
+        void help() {}
+    };
+
+    inline snapshot collect() { return {}; }
+    inline void reset() {}
+#endif
+
+    // One line per site with any ops : counts, failure rate, and the retry histogram
+    inline void dump(std::FILE *out = stdout)
+    {
+        if (!enabled)
+        {
+            std::fprintf(out, "contention stats disabled (build with -DLF_CONTENTION_STATS)\n");
+            return;
+        }
+        auto snap = collect();
+        std::fprintf(out, "%-26s %12s %12s %7s %10s   retries/op:", "site", "ops", "cas", "fail%", "helps");
+        for (auto l : hist_labels)
+            std::fprintf(out, " %9s", l);
+        std::fprintf(out, "\n");
+        for (std::size_t s = 0; s < site_count; ++s)
+        {
+            auto &st = snap[s];
+            if (!st.ops)
+                continue;
+            std::fprintf(out, "%-26s %12llu %12llu %6.2f%% %10llu              ", site_names[s],
+                         static_cast<unsigned long long>(st.ops), static_cast<unsigned long long>(st.cas_attempts),
+                         st.cas_attempts ? 100.0 * st.cas_failures / st.cas_attempts : 0.0,
+                         static_cast<unsigned long long>(st.helps));
+            for (auto n : st.retries)
+                std::fprintf(out, " %9llu", static_cast<unsigned long long>(n));
+            std::fprintf(out, "\n");
+        }
+    }
+}
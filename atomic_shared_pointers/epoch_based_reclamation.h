@@ -0,0 +1,276 @@
+// Epoch-based reclamation (Fraser's EBR)
+
+// Readers don't announce individual pointers like with hazard pointers, they only announce that
+// they are inside a critical section, once per operation, by copying the global epoch into their
+// thread record (a guard does that). Traversals then read plain pointers without any RMW or fence.
+
+// An object unlinked and retired while the global epoch is e can still be referenced only by
+// threads pinned at an epoch <= e. The global epoch moves from e to e + 1 only once every active
+// thread has been seen pinned at e, so when it reaches e + 2 all those threads have left their
+// critical sections and the object can be freed.
+
+// Each thread keeps 3 limbo lists (one per epoch mod 3). Every `advance_threshold` retires it tries
+// to advance the global epoch and frees the lists which became safe. Lists left over when a
+// thread exits are handed to a global orphan list and freed by whoever advances next.
+
+// The catch : a thread stalled inside a guard blocks the epoch, and with it all reclamation.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "asp_policy.h"
+
+namespace ebr
+{
+    class domain
+    {
+    public:
+        static constexpr std::size_t advance_threshold = 64;
+
+    private:
+        struct retired
+        {
+            void *p;
+            void (*del)(void *);
+        };
+
+        struct limbo
+        {
+            std::uint64_t epoch{0};
+            std::vector<retired> objs;
+            void free_all()
+            {
+                for (auto &r : objs)
+                    r.del(r.p);
+                objs.clear();
+            }
+        };
+
+        // (epoch << 1) | active, one per thread, reused after the thread exits
+        struct thread_rec
+        {
+            std::atomic<std::uint64_t> state{0};
+            std::atomic<bool> in_use{true};
+            thread_rec *next{};
+        };
+
+        struct orphan
+        {
+            limbo objs;
+            orphan *next{};
+        };
+
+        std::atomic<std::uint64_t> global_epoch{2}; // start at 2 so that epoch - 2 never wraps
+        std::atomic<thread_rec *> recs{nullptr};
+        std::atomic<orphan *> orphans{nullptr};
+
+        struct thread_state
+        {
+            domain *d;
+            thread_rec *rec;
+            std::size_t nesting{0};
+            std::size_t since_advance{0};
+            limbo lists[3];
+
+            explicit thread_state(domain *d_) : d{d_}, rec{d_->acquire_rec()} {}
+            ~thread_state()
+            {
+                for (auto &l : lists)
+                    if (!l.objs.empty())
+                        d->push_orphan(std::move(l));
+                rec->state.store(0, std::memory_order_release);
+                rec->in_use.store(false, std::memory_order_release);
+            }
+        };
+
+        thread_state &local()
+        {
+            thread_local thread_state state{this};
+            return state;
+        }
+
+        thread_rec *acquire_rec()
+        {
+            for (auto r = recs.load(std::memory_order_acquire); r; r = r->next)
+            {
+                bool expected = false;
+                if (!r->in_use.load(std::memory_order_relaxed) && r->in_use.compare_exchange_strong(expected, true))
+                    return r;
+            }
+            auto r = new thread_rec;
+            auto h = recs.load(std::memory_order_relaxed);
+            do
+            {
+                r->next = h;
+            } while (!recs.compare_exchange_weak(h, r, std::memory_order_release, std::memory_order_relaxed));
+            return r;
+        }
+
+        void push_orphan(limbo &&l)
+        {
+            auto o = new orphan{std::move(l)};
+            auto h = orphans.load(std::memory_order_relaxed);
+            do
+            {
+                o->next = h;
+            } while (!orphans.compare_exchange_weak(h, o, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        // Advances the global epoch if every active thread is pinned at the current one
+        std::uint64_t try_advance()
+        {
+            auto e = global_epoch.load();
+            for (auto r = recs.load(std::memory_order_acquire); r; r = r->next)
+            {
+                auto s = r->state.load();
+                if ((s & 1) && (s >> 1) != e)
+                    return e;
+            }
+            global_epoch.compare_exchange_strong(e, e + 1);
+            return global_epoch.load();
+        }
+
+        void free_orphans(std::uint64_t e)
+        {
+            orphan *keep = nullptr, *keep_last = nullptr;
+            for (auto o = orphans.exchange(nullptr, std::memory_order_acquire); o;)
+            {
+                auto next = o->next;
+                if (o->objs.epoch + 2 <= e)
+                {
+                    o->objs.free_all();
+                    delete o;
+                }
+                else
+                {
+                    o->next = keep;
+                    if (!keep)
+                        keep_last = o;
+                    keep = o;
+                }
+                o = next;
+            }
+            if (!keep) // put back what isn't safe yet
+                return;
+            auto h = orphans.load(std::memory_order_relaxed);
+            do
+            {
+                keep_last->next = h;
+            } while (!orphans.compare_exchange_weak(h, keep, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        domain() = default; // single instance, see default_domain() (thread_local state is per thread, not per domain)
+        friend domain &default_domain();
+
+    public:
+        domain(const domain &) = delete;
+        domain &operator=(const domain &) = delete;
+        ~domain()
+        {
+            // thread_local states are gone by now, only orphans are left
+            for (auto o = orphans.exchange(nullptr); o;)
+            {
+                o->objs.free_all();
+                delete std::exchange(o, o->next);
+            }
+            for (auto r = recs.exchange(nullptr); r;)
+                delete std::exchange(r, r->next);
+        }
+
+        void enter()
+        {
+            auto &ts = local();
+            if (ts.nesting++ == 0)
+            {
+                ts.rec->state.store((global_epoch.load() << 1) | 1);
+                // pin must be visible before we read any shared pointer
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        void exit()
+        {
+            auto &ts = local();
+            if (--ts.nesting == 0)
+                ts.rec->state.store(0, std::memory_order_release);
+        }
+
+        // p must already be unlinked, ie unreachable for threads entering from now on
+        template <typename T>
+        void retire(T *p)
+        {
+            auto &ts = local();
+            auto e = global_epoch.load();
+            auto &l = ts.lists[e % 3];
+            if (l.epoch != e) // holds objects from epoch e - 3 or older : safe
+            {
+                l.free_all();
+                l.epoch = e;
+            }
+            l.objs.push_back({p, [](void *q)
+                              { delete static_cast<T *>(q); }});
+            if (++ts.since_advance >= advance_threshold)
+            {
+                ts.since_advance = 0;
+                e = try_advance();
+                for (auto &list : ts.lists)
+                    if (list.epoch + 2 <= e)
+                        list.free_all();
+                free_orphans(e);
+            }
+        }
+    };
+
+    inline domain &default_domain()
+    {
+        static domain d;
+        return d;
+    }
+
+    // RAII critical section : pointers read inside stay valid until the guard dies
+    class guard
+    {
+    public:
+        guard() { default_domain().enter(); }
+        ~guard() { default_domain().exit(); }
+        guard(const guard &) = delete;
+        guard &operator=(const guard &) = delete;
+    };
+
+    // Pointer policy (see asp_policy.h) : plain pointers, valid while a guard is held,
+    // unlinked nodes must be handed to retire()
+    struct ebr_policy
+    {
+        template <typename U>
+        struct node_base
+        {
+        };
+        template <typename U>
+        using shared = U *;
+        template <typename U>
+        using atomic_shared = std::atomic<U *>;
+        using guard = ebr::guard;
+
+        template <typename U, typename... Args>
+        static shared<U> make(Args &&...args)
+        {
+            return new U(std::forward<Args>(args)...);
+        }
+        template <typename U, typename Alloc, typename... Args>
+        static shared<U> allocate(const Alloc &, Args &&...args)
+        {
+            static_assert(asp::is_std_allocator_v<Alloc>, "ebr_policy allocates with new");
+            return make<U>(std::forward<Args>(args)...);
+        }
+        template <typename U>
+        static void retire(U *p)
+        {
+            default_domain().retire(p);
+        }
+    };
+}
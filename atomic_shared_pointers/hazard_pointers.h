@@ -0,0 +1,341 @@
+// A small self-contained hazard pointer domain (Maged Michael's scheme)
+// Mirrors the subset of folly's API used here (hazptr_obj_base / retire, hazptr_holder / protect)
+// so hazard_ptr_asp.h runs without folly.
+
+// Hazard records : a global lock-free list of records, each publishing at most one pointer.
+// Records are never freed while the program runs, a released record is marked inactive and
+// reused. Each thread keeps a few records cached, so make_hazard_pointer() on the fast path is
+// just a pop from a thread_local array.
+
+// Retirement : each thread appends retired objects to its own list (intrusive, no allocation).
+// Once the list reaches the threshold (max(retire_threshold, 2 * no of records), which keeps
+// scans amortized O(1) per retire), the thread scans : snapshot all published hazards into a
+// sorted vector, then free every retired object not found in it by binary search and keep the
+// rest for the next scan.
+// Objects still protected when a thread exits are handed to a global orphan list, which the next
+// scan of any thread adopts. reclaim_all() frees everything retired regardless of hazards, for
+// shutdown once no other thread touches the protected structures anymore.
+// Objects must not be retired from static destructors (the thread_local state is gone by then).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace hazptr
+{
+    class domain;
+    domain &default_domain();
+
+    // Base of everything that can be retired, links the object into retire lists
+    struct hazptr_obj
+    {
+        hazptr_obj *next_retired{};
+        void (*reclaim)(hazptr_obj *){};
+        const void *addr{}; // address as published by protect(), ie of the most derived object
+    };
+
+    struct hazard_rec
+    {
+        std::atomic<const void *> ptr{nullptr};
+        std::atomic<bool> active{false};
+        hazard_rec *next{};
+    };
+
+    class domain
+    {
+    public:
+        static constexpr std::size_t retire_threshold = 128;
+        static constexpr std::size_t cached_recs = 8; // hazard records kept per thread
+
+    private:
+        std::atomic<hazard_rec *> recs{nullptr};
+        std::atomic<std::size_t> rec_count{0};
+        std::atomic<hazptr_obj *> orphans{nullptr};
+        std::atomic<std::size_t> unreclaimed{0};
+        std::atomic<std::size_t> peak_unreclaimed{0};
+        bool shutting_down{false}; // set by ~domain, retire() then frees right away
+
+        struct thread_state
+        {
+            domain *d;
+            hazard_rec *cache[cached_recs]{};
+            std::size_t cached{0};
+            hazptr_obj *retired{};
+            std::size_t retired_count{0};
+            bool scanning{false};
+
+            explicit thread_state(domain *d_) : d{d_} {}
+            ~thread_state()
+            {
+                for (std::size_t i = 0; i < cached; ++i)
+                    cache[i]->active.store(false, std::memory_order_release);
+                // reclaiming may retire more (eg a freed node dropping its successor), go until stuck
+                while (retired && d->scan(*this))
+                    ;
+                if (retired) // still protected somewhere : let another thread finish the job
+                {
+                    auto last = retired;
+                    while (last->next_retired)
+                        last = last->next_retired;
+                    d->push_orphans(retired, last);
+                }
+            }
+        };
+
+        thread_state &local()
+        {
+            thread_local thread_state state{this};
+            return state;
+        }
+
+        void push_orphans(hazptr_obj *first, hazptr_obj *last)
+        {
+            auto h = orphans.load(std::memory_order_relaxed);
+            do
+            {
+                last->next_retired = h;
+            } while (!orphans.compare_exchange_weak(h, first, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        hazard_rec *acquire_global()
+        {
+            for (auto r = recs.load(std::memory_order_acquire); r; r = r->next)
+            {
+                bool expected = false;
+                if (!r->active.load(std::memory_order_relaxed) && r->active.compare_exchange_strong(expected, true))
+                    return r;
+            }
+            auto r = new hazard_rec;
+            r->active.store(true, std::memory_order_relaxed);
+            auto h = recs.load(std::memory_order_relaxed);
+            do
+            {
+                r->next = h;
+            } while (!recs.compare_exchange_weak(h, r, std::memory_order_release, std::memory_order_relaxed));
+            rec_count.fetch_add(1, std::memory_order_relaxed);
+            return r;
+        }
+
+        void reclaim(hazptr_obj *obj)
+        {
+            obj->reclaim(obj);
+            unreclaimed.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void reclaim_list(hazptr_obj *obj)
+        {
+            while (obj)
+                reclaim(std::exchange(obj, obj->next_retired));
+        }
+
+        // Returns the no of objects freed
+        // Reclaiming an object may retire others : they land in ts.retired while we scan, but only
+        // the next scan looks at them (scanning blocks nested scans)
+        std::size_t scan(thread_state &ts)
+        {
+            // adopt orphans of exited threads
+            if (auto o = orphans.exchange(nullptr, std::memory_order_acquire))
+            {
+                auto last = o;
+                std::size_t n = 1;
+                for (; last->next_retired; last = last->next_retired)
+                    ++n;
+                last->next_retired = ts.retired;
+                ts.retired = o;
+                ts.retired_count += n;
+            }
+
+            // pairs with the seq_cst store in protect() : either the protector sees the object
+            // unlinked and retries, or we see its hazard
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::vector<const void *> hazards;
+            hazards.reserve(rec_count.load(std::memory_order_relaxed));
+            for (auto r = recs.load(std::memory_order_acquire); r; r = r->next)
+                if (auto p = r->ptr.load(std::memory_order_acquire))
+                    hazards.push_back(p);
+            std::sort(hazards.begin(), hazards.end());
+
+            hazptr_obj *keep = nullptr, *keep_last = nullptr;
+            std::size_t kept = 0, freed = 0;
+            auto obj = std::exchange(ts.retired, nullptr);
+            ts.retired_count = 0;
+            ts.scanning = true;
+            while (obj)
+            {
+                auto next = obj->next_retired;
+                if (std::binary_search(hazards.begin(), hazards.end(), obj->addr))
+                {
+                    obj->next_retired = keep;
+                    if (!keep)
+                        keep_last = obj;
+                    keep = obj;
+                    ++kept;
+                }
+                else
+                {
+                    reclaim(obj);
+                    ++freed;
+                }
+                obj = next;
+            }
+            ts.scanning = false;
+            if (keep) // survivors go back in front of whatever got retired meanwhile
+            {
+                keep_last->next_retired = ts.retired;
+                ts.retired = keep;
+                ts.retired_count += kept;
+            }
+            return freed;
+        }
+
+        domain() = default; // single instance, see default_domain() (thread_local state is per thread, not per domain)
+        friend domain &default_domain();
+
+    public:
+        domain(const domain &) = delete;
+        domain &operator=(const domain &) = delete;
+        ~domain()
+        {
+            // thread_local states are gone by now (exited threads orphaned their leftovers)
+            shutting_down = true;
+            reclaim_list(orphans.exchange(nullptr, std::memory_order_acquire));
+            for (auto r = recs.exchange(nullptr); r;)
+                delete std::exchange(r, r->next);
+        }
+
+        hazard_rec *acquire()
+        {
+            auto &ts = local();
+            if (ts.cached)
+                return ts.cache[--ts.cached];
+            return acquire_global();
+        }
+
+        void release(hazard_rec *r)
+        {
+            r->ptr.store(nullptr, std::memory_order_release);
+            auto &ts = local();
+            if (ts.cached < cached_recs)
+                ts.cache[ts.cached++] = r;
+            else
+                r->active.store(false, std::memory_order_release);
+        }
+
+        void retire(hazptr_obj *obj)
+        {
+            auto n = unreclaimed.fetch_add(1, std::memory_order_relaxed) + 1;
+            auto peak = peak_unreclaimed.load(std::memory_order_relaxed);
+            while (n > peak && !peak_unreclaimed.compare_exchange_weak(peak, n, std::memory_order_relaxed))
+                ;
+            if (shutting_down)
+                return reclaim(obj);
+            auto &ts = local();
+            obj->next_retired = ts.retired;
+            ts.retired = obj;
+            if (++ts.retired_count >= std::max(retire_threshold, 2 * rec_count.load(std::memory_order_relaxed)) && !ts.scanning)
+                scan(ts);
+        }
+
+        // Frees every retired object of the calling thread and exited threads, ignoring hazards
+        // Only for shutdown : no thread may still access objects reachable from the domain
+        void reclaim_all()
+        {
+            auto &ts = local();
+            while (ts.retired || orphans.load(std::memory_order_relaxed)) // reclaiming may retire more
+            {
+                ts.retired_count = 0;
+                reclaim_list(std::exchange(ts.retired, nullptr));
+                reclaim_list(orphans.exchange(nullptr, std::memory_order_acquire));
+            }
+        }
+
+        // Retired but not yet freed, and its high-water mark
+        std::size_t unreclaimed_count() const { return unreclaimed.load(std::memory_order_relaxed); }
+        std::size_t peak_unreclaimed_count() const { return peak_unreclaimed.load(std::memory_order_relaxed); }
+        void reset_peak() { peak_unreclaimed.store(unreclaimed.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+    };
+
+    inline domain &default_domain()
+    {
+        static domain d;
+        return d;
+    }
+
+    // CRTP base for retirable objects, like folly::hazptr_obj_base
+    template <typename T>
+    struct hazptr_obj_base : hazptr_obj
+    {
+        void retire()
+        {
+            reclaim = [](hazptr_obj *obj)
+            { delete static_cast<T *>(obj); };
+            addr = static_cast<T *>(this);
+            default_domain().retire(this);
+        }
+    };
+
+    // Owns one hazard record, like folly::hazptr_holder
+    class hazptr_holder
+    {
+        hazard_rec *rec{};
+
+    public:
+        hazptr_holder() = default;
+        explicit hazptr_holder(hazard_rec *r) : rec{r} {}
+        hazptr_holder(const hazptr_holder &) = delete;
+        hazptr_holder &operator=(const hazptr_holder &) = delete;
+        hazptr_holder(hazptr_holder &&other) noexcept : rec{std::exchange(other.rec, nullptr)} {}
+        hazptr_holder &operator=(hazptr_holder &&other) noexcept
+        {
+            hazptr_holder(std::move(other)).swap(*this);
+            return *this;
+        }
+        ~hazptr_holder()
+        {
+            if (rec)
+                default_domain().release(rec);
+        }
+        void swap(hazptr_holder &other) noexcept
+        {
+            std::swap(rec, other.rec);
+        }
+
+        // Publishes src's current value and returns it once it is stable
+        // (src still holds it after publishing, so a scan after the unlink must see the hazard)
+        template <typename T>
+        T *protect(const std::atomic<T *> &src)
+        {
+            auto p = src.load(std::memory_order_relaxed);
+            while (true)
+            {
+                rec->ptr.store(p, std::memory_order_seq_cst);
+                auto q = src.load(std::memory_order_acquire);
+                if (q == p)
+                    return p;
+                p = q;
+            }
+        }
+
+        // Publishes p without validating it, like folly's reset_protection(ptr) : the caller has to
+        // check that p is still reachable afterwards (eg through a marked pointer protect() can't read)
+        template <typename T>
+        void reset_protection(const T *p)
+        {
+            rec->ptr.store(p, std::memory_order_seq_cst);
+        }
+
+        void reset_protection()
+        {
+            rec->ptr.store(nullptr, std::memory_order_release);
+        }
+    };
+
+    inline hazptr_holder make_hazard_pointer()
+    {
+        return hazptr_holder{default_domain().acquire()};
+    }
+}
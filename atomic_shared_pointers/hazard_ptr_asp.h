@@ -3,12 +3,14 @@
 #include <atomic>
 #include <memory>
 #include <utility>
-#include <folly/synchronization/Hazptr.h>
+#include "hazard_pointers.h"
+#include "asp_policy.h"
+#include "contention_stats.h"
 
 namespace asp
 {
     template <typename T>
-    struct basic_control_block : public folly::hazptr_obj_base<basic_control_block<T>>
+    struct basic_control_block : public hazptr::hazptr_obj_base<basic_control_block<T>>
     {
         std::atomic<int64_t> ref_count{1};
         T *ptr{};
@@ -17,7 +19,12 @@ namespace asp
         basic_control_block(T *ptr_) : ptr{ptr_} {}
         basic_control_block(const basic_control_block &) = delete;
         basic_control_block &operator=(const basic_control_block &) = delete;
-        ~basic_control_block() = default;
+        // the object lives as long as its control block, so a hazard on the block protects both
+        // (see snapshot_ptr)
+        ~basic_control_block()
+        {
+            delete ptr;
+        }
 
         // Increment the reference count.  The reference count must not be zero
         void increment_count() noexcept
@@ -28,8 +35,9 @@ namespace asp
         // Increment the reference count if it is not zero.
         bool increment_if_nonzero() noexcept
         {
+            contention::op_scope op{contention::site::asp_increment_if_nonzero};
             auto cnt = ref_count.load();
-            while (cnt > 0 && !ref_count.compare_exchange_weak(cnt, cnt + 1))
+            while (cnt > 0 && !op.cas(ref_count.compare_exchange_weak(cnt, cnt + 1)))
                 ;
             return cnt > 0;
         }
@@ -39,8 +47,7 @@ namespace asp
         {
             if (ref_count.fetch_sub(1) == 1)
             {
-                delete ptr;
-                this->retire();
+                this->retire(); // object is destroyed with the block, once no snapshot protects it
             }
         }
     };
@@ -87,6 +94,75 @@ namespace asp
         {
             std::swap(control_block, other.control_block);
         }
+        T *get() const noexcept
+        {
+            return control_block ? control_block->ptr : nullptr;
+        }
+        T *operator->() const noexcept
+        {
+            return get();
+        }
+        T &operator*() const noexcept
+        {
+            return *get();
+        }
+        explicit operator bool() const noexcept
+        {
+            return control_block != nullptr;
+        }
+        friend bool operator==(const shared_ptr &a, const shared_ptr &b) noexcept
+        {
+            return a.control_block == b.control_block;
+        }
+    };
+
+    // Non-owning view of the value an atomic_shared_ptr held when the snapshot was taken
+    // Keeps the object alive with a hazard pointer instead of a reference count, so taking one never
+    // writes to the control block. Move-only since it owns a hazard record, keep it short lived :
+    // every snapshot alive delays reclamation of what it protects and holds a hazard record.
+    template <typename T>
+    class snapshot_ptr
+    {
+        hazptr::hazptr_holder hp;
+        basic_control_block<T> *control_block{nullptr};
+
+    public:
+        snapshot_ptr() = default;
+        snapshot_ptr(hazptr::hazptr_holder hp_, basic_control_block<T> *control_block_) noexcept
+            : hp{std::move(hp_)}, control_block{control_block_} {}
+        snapshot_ptr(snapshot_ptr &&other) noexcept
+            : hp{std::move(other.hp)}, control_block{std::exchange(other.control_block, nullptr)} {}
+        snapshot_ptr &operator=(snapshot_ptr &&other) noexcept
+        {
+            hp = std::move(other.hp);
+            control_block = std::exchange(other.control_block, nullptr);
+            return *this;
+        }
+
+        // Upgrades to an owning pointer. Empty if the last owner dropped the object meanwhile
+        // (it is still readable through the snapshot, but can't be brought back to life)
+        shared_ptr<T> to_shared() const noexcept
+        {
+            if (control_block && control_block->increment_if_nonzero())
+                return shared_ptr<T>(control_block);
+            return {};
+        }
+        T *get() const noexcept
+        {
+            return control_block ? control_block->ptr : nullptr;
+        }
+        T *operator->() const noexcept
+        {
+            return get();
+        }
+        T &operator*() const noexcept
+        {
+            return *get();
+        }
+        explicit operator bool() const noexcept
+        {
+            return control_block != nullptr;
+        }
     };
 
     template <typename T>
@@ -110,7 +186,7 @@ namespace asp
         }
         shared_ptr<T> load()
         {
-            folly::hazptr_holder hp = folly::make_hazard_pointer();
+            hazptr::hazptr_holder hp = hazptr::make_hazard_pointer();
             basic_control_block<T> *current_control_block = nullptr;
             do
             {
@@ -120,6 +196,17 @@ namespace asp
             return shared_ptr<T>(current_control_block);
         }
 
+        // Protects the current value with a hazard pointer only : no ref count increment, so
+        // concurrent readers don't bounce the control block's cache line between them
+        snapshot_ptr<T> get_snapshot()
+        {
+            hazptr::hazptr_holder hp = hazptr::make_hazard_pointer();
+            auto current_control_block = hp.protect(control_block);
+            // still published by *this after protecting => its count was nonzero, and the block
+            // (object included) can't be reclaimed until the hazard goes away
+            return snapshot_ptr<T>(std::move(hp), current_control_block);
+        }
+
         void store(shared_ptr<T> desired)
         {
             auto new_control_block = std::exchange(desired.control_block, nullptr);
@@ -129,5 +216,49 @@ namespace asp
                 old_control_block->decrement_count();
             }
         }
+
+        // On success the reference held by desired moves into *this and the reference
+        // previously held by *this is dropped. On failure expected is reloaded, which
+        // may observe the old value again if it was swapped back in the meantime.
+        bool compare_exchange_strong(shared_ptr<T> &expected, shared_ptr<T> desired)
+        {
+            auto expected_control_block = expected.control_block;
+            if (control_block.compare_exchange_strong(expected_control_block, desired.control_block))
+            {
+                desired.control_block = nullptr;
+                if (expected_control_block)
+                {
+                    expected_control_block->decrement_count();
+                }
+                return true;
+            }
+            expected = load();
+            return false;
+        }
+        bool compare_exchange_weak(shared_ptr<T> &expected, shared_ptr<T> desired)
+        {
+            return compare_exchange_strong(expected, std::move(desired));
+        }
+    };
+
+    // Pointer policy (see asp_policy.h)
+    struct hazard_ptr_policy : refcounting_policy
+    {
+        template <typename U>
+        using shared = shared_ptr<U>;
+        template <typename U>
+        using atomic_shared = atomic_shared_ptr<U>;
+
+        template <typename U, typename... Args>
+        static shared<U> make(Args &&...args)
+        {
+            return shared<U>(new U(std::forward<Args>(args)...));
+        }
+        template <typename U, typename Alloc, typename... Args>
+        static shared<U> allocate(const Alloc &, Args &&...args)
+        {
+            static_assert(is_std_allocator_v<Alloc>, "hazard_ptr_policy allocates with new");
+            return make<U>(std::forward<Args>(args)...);
+        }
     };
 }
\ No newline at end of file
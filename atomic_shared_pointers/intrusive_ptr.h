@@ -0,0 +1,185 @@
+// Intrusive reference counting : the count lives in the object itself (ref_counted CRTP base)
+// instead of a separate control block, so there is one allocation per object and a pointer
+// leads straight to it, no ctrl block in between.
+// The price : only types deriving from ref_counted can be pointed to, and there are no aliasing
+// or weak pointers.
+
+// intrusive_ptr<T>         like shared_ptr, count starts at 0 and every intrusive_ptr holds one
+// atomic_intrusive_ptr<T>  split reference counting with the local count packed into the upper
+//                          16 bits of the pointer, the same packed_split_count (packed_split_count.h)
+//                          as packed_atomic_sp, so one plain 8 byte CAS does it and it is lock-free
+//                          wherever 8 byte atomics are. The global count is the object's.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include "asp_policy.h"
+#include "packed_split_count.h"
+
+namespace asp
+{
+    template <typename T>
+    class intrusive_ptr;
+    template <typename T>
+    class atomic_intrusive_ptr;
+
+    // CRTP base : struct node : asp::ref_counted<node> { ... };
+    template <typename Derived>
+    class ref_counted
+    {
+        std::atomic<int64_t> ref_cnt{0};
+
+        template <typename>
+        friend class intrusive_ptr;
+        template <typename>
+        friend class atomic_intrusive_ptr;
+
+        void add_ref(int64_t x = 1)
+        {
+            ref_cnt.fetch_add(x, std::memory_order_relaxed);
+        }
+        void release_ref(int64_t x = 1)
+        {
+            if (ref_cnt.fetch_sub(x, std::memory_order_acq_rel) == x)
+                delete static_cast<Derived *>(this);
+        }
+
+    protected:
+        ref_counted() = default;
+        ref_counted(const ref_counted &) {} // a copy is a new object, with its own count
+        ref_counted &operator=(const ref_counted &) { return *this; }
+        ~ref_counted() = default;
+
+    public:
+        // Includes the refs an atomic_intrusive_ptr holding the object keeps in reserve for loads
+        int64_t use_count() const { return ref_cnt.load(std::memory_order_relaxed); }
+    };
+
+    template <typename T>
+    class intrusive_ptr
+    {
+        T *ptr{};
+
+        friend class atomic_intrusive_ptr<T>;
+        struct adopt_t
+        {
+        };
+        intrusive_ptr(T *p, adopt_t) : ptr{p} {} // takes over a ref already counted
+
+    public:
+        intrusive_ptr() = default;
+        explicit intrusive_ptr(T *p) : ptr{p}
+        {
+            if (ptr)
+                ptr->add_ref();
+        }
+        intrusive_ptr(const intrusive_ptr &other) : intrusive_ptr{other.ptr} {}
+        intrusive_ptr &operator=(const intrusive_ptr &other)
+        {
+            intrusive_ptr(other).swap(*this);
+            return *this;
+        }
+        intrusive_ptr(intrusive_ptr &&other) noexcept : ptr{std::exchange(other.ptr, nullptr)} {}
+        intrusive_ptr &operator=(intrusive_ptr &&other) noexcept
+        {
+            intrusive_ptr(std::move(other)).swap(*this);
+            return *this;
+        }
+        ~intrusive_ptr()
+        {
+            if (ptr)
+                ptr->release_ref();
+        }
+        void swap(intrusive_ptr &other) noexcept
+        {
+            std::swap(ptr, other.ptr);
+        }
+        T *get() const { return ptr; }
+        T *operator->() const { return ptr; }
+        T &operator*() const { return *ptr; }
+        explicit operator bool() const { return ptr != nullptr; }
+        friend bool operator==(const intrusive_ptr &a, const intrusive_ptr &b) { return a.ptr == b.ptr; }
+    };
+
+    template <typename T, typename... Args>
+    intrusive_ptr<T> make_intrusive(Args &&...args)
+    {
+        return intrusive_ptr<T>(new T(std::forward<Args>(args)...));
+    }
+
+    template <typename T>
+    class atomic_intrusive_ptr
+    {
+        struct counts // atomic_intrusive_ptr is a friend of ref_counted, so are its members
+        {
+            static void add(T *p, int64_t x) { p->add_ref(x); }
+            static void sub(T *p, int64_t x) { p->release_ref(x); }
+        };
+
+        packed_split_count<T, counts> word;
+
+    public:
+        atomic_intrusive_ptr() = default;
+        atomic_intrusive_ptr(intrusive_ptr<T> desired) : word{std::exchange(desired.ptr, nullptr)} {}
+        atomic_intrusive_ptr(const atomic_intrusive_ptr &) = delete;
+        atomic_intrusive_ptr &operator=(const atomic_intrusive_ptr &) = delete;
+
+        intrusive_ptr<T> load()
+        {
+            return word.acquire([](T *p) { return intrusive_ptr<T>(p, typename intrusive_ptr<T>::adopt_t{}); });
+        }
+
+        void store(intrusive_ptr<T> desired)
+        {
+            word.store(std::exchange(desired.ptr, nullptr));
+        }
+
+        // Succeeds if *this still holds expected's object (whatever its local count)
+        // On failure expected is reloaded
+        bool compare_exchange_strong(intrusive_ptr<T> &expected, intrusive_ptr<T> desired)
+        {
+            if (word.compare_exchange(expected.get(), desired.get()))
+            {
+                desired.ptr = nullptr;
+                return true;
+            }
+            expected = load();
+            return false;
+        }
+        bool compare_exchange_weak(intrusive_ptr<T> &expected, intrusive_ptr<T> desired)
+        {
+            return compare_exchange_strong(expected, std::move(desired));
+        }
+
+        static constexpr bool is_always_lock_free = decltype(word)::is_always_lock_free;
+        bool is_lock_free() const
+        {
+            return word.is_lock_free();
+        }
+    };
+
+    // Pointer policy (see asp_policy.h) : nodes derive from node_base, ie carry their own count
+    struct intrusive_policy : refcounting_policy
+    {
+        template <typename U>
+        using node_base = ref_counted<U>;
+        template <typename U>
+        using shared = intrusive_ptr<U>;
+        template <typename U>
+        using atomic_shared = atomic_intrusive_ptr<U>;
+
+        template <typename U, typename... Args>
+        static shared<U> make(Args &&...args)
+        {
+            return make_intrusive<U>(std::forward<Args>(args)...);
+        }
+        template <typename U, typename Alloc, typename... Args>
+        static shared<U> allocate(const Alloc &, Args &&...args)
+        {
+            static_assert(is_std_allocator_v<Alloc>, "intrusive_policy allocates with new");
+            return make<U>(std::forward<Args>(args)...);
+        }
+    };
+}
@@ -0,0 +1,161 @@
+// Split reference counting in one 64 bit word (Solution 2 in notes.md) : the local ref count lives
+// in the upper 16 bits of the pointer, so the whole state takes a plain 8 byte CAS, lock-free
+// wherever 8 byte atomics are. Assumes 48 bit user-space virtual addresses (x86-64 with 4 level
+// paging, AArch64 48 bit VA).
+
+// The protocol, shared by packed_atomic_sp (packed_split_ref_cnt.h) and atomic_intrusive_ptr
+// (intrusive_ptr.h), which only differ in where the global count lives :
+//   Counts::add(Target *, n)   adds n to the target's global count
+//   Counts::sub(Target *, n)   takes n from it, destroying the target when it drops to zero
+
+// Installing a target adds a reserve of `reserve` refs to its global count up front, and the local
+// count says how many of them loaders have taken : a load is one CAS bumping it, and the loader
+// owns a global ref from then on, nothing left to give back. Whoever takes the target out of the
+// word returns the unused part of the reserve together with the word's own ref, in one sub.
+// (Giving local refs back to the word instead, as split_ref_cnt.h does, has a window : a loader
+// whose word was swapped out takes its ref off the global count before the swapper has moved the
+// local count there, and if it then drops its result the target dies under the swapper.)
+// A loader that finds the reserve half used tops it up : it adds half a reserve to the global
+// count, then takes that much off the local count if the target is still there, or back off the
+// global one if not. It owns a ref meanwhile, so the target can't go away under it. The count can
+// only saturate with 2^15 loaders between two top ups, then a loader yields instead of letting it
+// overflow into the pointer bits.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+
+namespace asp
+{
+    template <typename Target, typename Counts>
+    class packed_split_count
+    {
+        static_assert(sizeof(void *) == 8, "packing needs 64 bit pointers");
+        static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "needs a lock-free 8 byte atomic");
+
+        static constexpr std::uint64_t ptr_mask = (std::uint64_t{1} << 48) - 1;
+        static constexpr std::uint64_t one_ref = std::uint64_t{1} << 48; // 1 in the local count field
+        static constexpr std::uint64_t max_local = ~std::uint64_t{0} >> 48;
+
+        std::atomic<std::uint64_t> packed{0};
+
+        static Target *ptr_of(std::uint64_t w) { return reinterpret_cast<Target *>(w & ptr_mask); }
+        static std::uint64_t local_of(std::uint64_t w) { return w >> 48; }
+        static std::uint64_t pack(Target *p)
+        {
+            auto w = reinterpret_cast<std::uint64_t>(p);
+            assert((w & ~ptr_mask) == 0 && "address wider than 48 bits");
+            return w;
+        }
+
+        static constexpr auto reserve = static_cast<std::int64_t>(max_local);
+        static constexpr std::uint64_t top_up = max_local / 2;
+
+        // Adds the reserve for a target about to be installed
+        static Target *with_reserve(Target *owned)
+        {
+            if (owned)
+                Counts::add(owned, reserve);
+            return owned;
+        }
+
+        // Takes one ref from the reserve, returns the word as we left it
+        std::uint64_t take_local_ref()
+        {
+            auto w = packed.load();
+            while (true)
+            {
+                if (!ptr_of(w)) // nothing to take
+                    return w;
+                if (local_of(w) == max_local) // saturated : wait for a top up
+                {
+                    std::this_thread::yield();
+                    w = packed.load();
+                    continue;
+                }
+                if (packed.compare_exchange_weak(w, w + one_ref))
+                    return w + one_ref;
+            }
+        }
+
+        // Moves top_up refs into the reserve of p, caller owns a ref to p
+        void refill(Target *p)
+        {
+            Counts::add(p, static_cast<std::int64_t>(top_up));
+            auto w = packed.load();
+            while (ptr_of(w) == p && local_of(w) >= top_up)
+            {
+                if (packed.compare_exchange_weak(w, w - top_up * one_ref))
+                    return;
+            }
+            Counts::sub(p, static_cast<std::int64_t>(top_up)); // moved or topped up by someone else
+        }
+
+        // Drops the reference a word held along with what is left of its reserve
+        static void release(std::uint64_t old)
+        {
+            if (auto p = ptr_of(old))
+                Counts::sub(p, 1 + reserve - static_cast<std::int64_t>(local_of(old)));
+        }
+
+    public:
+        packed_split_count() = default;
+        explicit packed_split_count(Target *owned) : packed{pack(with_reserve(owned))} {} // takes over owned's ref
+        packed_split_count(const packed_split_count &) = delete;
+        packed_split_count &operator=(const packed_split_count &) = delete;
+        ~packed_split_count()
+        {
+            release(packed.load());
+        }
+
+        // Takes one global ref to the current target for the caller and returns adopt(target), which
+        // takes it over (adopt(nullptr) if empty)
+        template <typename Adopt>
+        auto acquire(Adopt adopt)
+        {
+            auto w = take_local_ref();
+            if (!ptr_of(w))
+                return adopt(nullptr);
+            auto result = adopt(ptr_of(w));
+            if (local_of(w) == top_up)
+                refill(ptr_of(w));
+            return result;
+        }
+
+        // Installs owned, taking over its ref, and drops the previous target's
+        void store(Target *owned)
+        {
+            release(packed.exchange(pack(with_reserve(owned))));
+        }
+
+        // Installs owned if expected is still there, whatever its local count
+        // On success takes over owned's ref and drops expected's, on failure touches neither
+        bool compare_exchange(Target *expected, Target *owned)
+        {
+            auto w = packed.load();
+            if (ptr_of(w) != expected)
+                return false;
+            with_reserve(owned);
+            do
+            {
+                if (packed.compare_exchange_weak(w, pack(owned)))
+                {
+                    release(w);
+                    return true;
+                }
+            } while (ptr_of(w) == expected);
+            if (owned) // caller still holds its own ref, this never drops to zero
+                Counts::sub(owned, reserve);
+            return false;
+        }
+
+        static constexpr bool is_always_lock_free = std::atomic<std::uint64_t>::is_always_lock_free;
+        bool is_lock_free() const
+        {
+            return packed.is_lock_free();
+        }
+    };
+}
@@ -0,0 +1,78 @@
+// Split reference counting with a packed pointer (Solution 2 in notes.md)
+
+// asp::atomic_sp keeps {ctrl_blk*, local_ref_cnt} in a 16 byte std::atomic, which is lock-free
+// only where the compiler emits cmpxchg16b / casp, otherwise libatomic silently takes a lock.
+// Here the local ref count lives in the upper 16 bits of the ctrl block pointer instead, so the
+// whole state is one 64 bit word and every operation is a plain 8 byte CAS. The protocol is
+// packed_split_count (packed_split_count.h), with the global count in the ctrl block.
+
+// Same ctrl_blk / shd_ptr as split_ref_cnt.h, so values move freely between both.
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include "packed_split_count.h"
+#include "split_ref_cnt.h"
+
+namespace asp
+{
+    template <typename T>
+    class packed_atomic_sp
+    {
+        struct counts
+        {
+            static void add(ctrl_blk<T> *cb, int64_t x) { cb->add_ref_cnt(x); }
+            static void sub(ctrl_blk<T> *cb, int64_t x) { cb->sub_ref_cnt(x); }
+        };
+
+        packed_split_count<ctrl_blk<T>, counts> word;
+
+    public:
+        packed_atomic_sp() = default;
+        explicit packed_atomic_sp(T *p) : word{new ctrl_blk<T>{p}} {}
+        packed_atomic_sp(shd_ptr<T> desired) : word{std::exchange(desired.cb, nullptr)} {}
+        packed_atomic_sp(const packed_atomic_sp &) = delete;
+        packed_atomic_sp &operator=(const packed_atomic_sp &) = delete;
+
+        shd_ptr<T> load()
+        {
+            return word.acquire([](ctrl_blk<T> *cb) { return shd_ptr<T>(cb); });
+        }
+
+        void store(shd_ptr<T> desired)
+        {
+            word.store(std::exchange(desired.cb, nullptr));
+        }
+
+        // Succeeds if *this still holds expected's ctrl block (whatever its local count)
+        // On failure expected is reloaded
+        bool compare_exchange_strong(shd_ptr<T> &expected, shd_ptr<T> desired)
+        {
+            if (word.compare_exchange(expected.cb, desired.cb))
+            {
+                desired.cb = nullptr;
+                return true;
+            }
+            expected = load();
+            return false;
+        }
+        bool compare_exchange_weak(shd_ptr<T> &expected, shd_ptr<T> desired)
+        {
+            return compare_exchange_strong(expected, std::move(desired));
+        }
+
+        static constexpr bool is_always_lock_free = decltype(word)::is_always_lock_free;
+        bool is_lock_free() const
+        {
+            return word.is_lock_free();
+        }
+    };
+
+    // Pointer policy (see asp_policy.h)
+    struct packed_split_ref_cnt_policy : split_ref_cnt_policy
+    {
+        template <typename U>
+        using atomic_shared = packed_atomic_sp<U>;
+    };
+}
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include "asp_policy.h"
 
 namespace asp
 {
@@ -9,6 +13,10 @@ namespace asp
     {
         ctrl_blk() = default;
         ctrl_blk(T *p) : ptr{p} {}
+        ~ctrl_blk()
+        {
+            delete ptr;
+        }
         void add_ref_cnt(int64_t x)
         {
             ref_cnt.fetch_add(x);
@@ -31,13 +39,44 @@ namespace asp
     public:
         ctrl_blk<T> *cb{};
         shd_ptr() = default;
-        shd_ptr(T *p) : cb{new ctrl_blk<T>{p}} {}
-        shd_ptr(ctrl_blk<T> *cptr) : cb{cptr} {}
+        explicit shd_ptr(T *p) : cb{new ctrl_blk<T>{p}} {}
+        explicit shd_ptr(ctrl_blk<T> *cptr) : cb{cptr} {}
+        shd_ptr(const shd_ptr &other) : cb{other.cb}
+        {
+            if (cb)
+                cb->add_ref_cnt(1);
+        }
+        shd_ptr &operator=(const shd_ptr &other)
+        {
+            shd_ptr(other).swap(*this);
+            return *this;
+        }
+        shd_ptr(shd_ptr &&other) noexcept : cb{std::exchange(other.cb, nullptr)} {}
+        shd_ptr &operator=(shd_ptr &&other) noexcept
+        {
+            shd_ptr(std::move(other)).swap(*this);
+            return *this;
+        }
         ~shd_ptr()
         {
             if (cb)
                 cb->sub_ref_cnt(1);
         }
+        void swap(shd_ptr &other) noexcept
+        {
+            std::swap(cb, other.cb);
+        }
+        T *get() const { return cb ? cb->ptr : nullptr; }
+        // No null branch like get() : gcc would follow it into callers that know the pointer is
+        // set (lf_queue's tail) and warn about loads through old_tail->next at address 0
+        T *operator->() const
+        {
+            assert(cb && "dereferencing an empty shd_ptr");
+            return cb->ptr;
+        }
+        T &operator*() const { return *operator->(); }
+        explicit operator bool() const { return cb != nullptr; }
+        friend bool operator==(const shd_ptr &a, const shd_ptr &b) { return a.cb == b.cb; }
     };
 
     template <typename T>
@@ -59,6 +98,8 @@ namespace asp
             counted_ptr new_ccb;
             do
             {
+                if (!old_ccb.cb) // nothing to protect
+                    return old_ccb;
                 new_ccb = old_ccb;
                 new_ccb.local_ref_cnt++;
             } while (!ccb.compare_exchange_weak(old_ccb, new_ccb));
@@ -82,33 +123,97 @@ namespace asp
             }
         }
 
+        // local_ref_cnt is moved to global_ref_cnt
+        // => old ctrl block not deleted if any in-flight loads
+        // then my reference to old ctrl block is over
+        static void release(counted_ptr old_ccb)
+        {
+            if (!old_ccb.cb)
+                return;
+            old_ccb.cb->add_ref_cnt(old_ccb.local_ref_cnt);
+            old_ccb.cb->sub_ref_cnt(1);
+        }
+
     public:
         atomic_sp() = default;
-        atomic_sp<T>(T *p) : ccb{new ctrl_blk<T>{p}} {}
+        explicit atomic_sp(T *p) : ccb{new ctrl_blk<T>{p}} {}
+        atomic_sp(shd_ptr<T> desired) : ccb{std::exchange(desired.cb, nullptr)} {}
+        atomic_sp(const atomic_sp &) = delete;
+        atomic_sp &operator=(const atomic_sp &) = delete;
+        ~atomic_sp()
+        {
+            release(ccb.load());
+        }
+
         shd_ptr<T> load()
         {
             // read the control block and simultaneously increment local ref_cnt to secure it
             auto new_ccb = incr_local_ref_cnt();
+            if (!new_ccb.cb)
+                return {};
             // since control block is securely there, increment global ref_cnt
             new_ccb.cb->add_ref_cnt(1);
             // generate result
             auto result = shd_ptr<T>(new_ccb.cb);
             // decrement local ref_cnt since load complete
-            decr_local_ref_cnt(ccb.load());
+            decr_local_ref_cnt(new_ccb);
             return result;
         }
 
         void store(shd_ptr<T> desired)
         {
-            counted_ptr new_ccb{desired.cb, 0};
             // my ptr will now point to supplied ctrl block and 0 local ref count
-            auto old_ccb = ccb.exchange(new_ccb);
-            // local_ref_cnt is moved to global_ref_cnt
-            // => old ctrl block not deleted if any in-flight loads
-            old_ccb.cb->add_ref_cnt(old_ccb.local_ref_cnt);
-            // my reference to old ctrl block is over
-            old_ccb.cb->sub_ref_cnt(1);
-            desired.cb = nullptr;
+            auto old_ccb = ccb.exchange(counted_ptr{std::exchange(desired.cb, nullptr)});
+            release(old_ccb);
+        }
+
+        // Succeeds if *this still holds expected's ctrl block (whatever its local_ref_cnt)
+        // On failure expected is reloaded
+        bool compare_exchange_strong(shd_ptr<T> &expected, shd_ptr<T> desired)
+        {
+            auto old_ccb = ccb.load();
+            while (old_ccb.cb == expected.cb)
+            {
+                if (ccb.compare_exchange_weak(old_ccb, counted_ptr{desired.cb}))
+                {
+                    desired.cb = nullptr;
+                    release(old_ccb);
+                    return true;
+                }
+            }
+            expected = load();
+            return false;
+        }
+        bool compare_exchange_weak(shd_ptr<T> &expected, shd_ptr<T> desired)
+        {
+            return compare_exchange_strong(expected, std::move(desired));
+        }
+
+        bool is_lock_free() const
+        {
+            return ccb.is_lock_free();
+        }
+    };
+
+    // Pointer policy (see asp_policy.h)
+    // 16 byte std::atomic : link with -latomic, lock-free only where the target has a double-word CAS
+    struct split_ref_cnt_policy : refcounting_policy
+    {
+        template <typename U>
+        using shared = shd_ptr<U>;
+        template <typename U>
+        using atomic_shared = atomic_sp<U>;
+
+        template <typename U, typename... Args>
+        static shared<U> make(Args &&...args)
+        {
+            return shared<U>(new U(std::forward<Args>(args)...));
+        }
+        template <typename U, typename Alloc, typename... Args>
+        static shared<U> allocate(const Alloc &, Args &&...args)
+        {
+            static_assert(is_std_allocator_v<Alloc>, "split_ref_cnt_policy allocates with new");
+            return make<U>(std::forward<Args>(args)...);
         }
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,129 @@
+// Atomic shared pointer implementations head to head :
+//   std::atomic<std::shared_ptr>   asp::std_policy
+//   asp::atomic_sp                 asp::split_ref_cnt_policy (split reference counting)
+//   asp::packed_atomic_sp          asp::packed_split_ref_cnt_policy (same, 8 byte packed pointer)
+//   asp::atomic_shared_ptr         asp::hazard_ptr_policy (deferred reclamation via hazard pointers)
+// Workloads : load-heavy (95% load), store-heavy (95% store) and mixed (50 / 50) on one shared
+// atomic, then lock_free::Stack and ms_queue::lf_queue with each implementation swapped in.
+// asp::atomic_shared_ptr also runs load-heavy with reads through get_snapshot().
+// Reports throughput and per-op latency percentiles for 1 .. max threads.
+
+// g++ -std=c++20 -O2 -pthread asp_bench.cpp -latomic
+// (split_ref_cnt.h uses a 16 byte std::atomic, add -mcx16 on x86-64 to give it a chance to be lock-free)
+// Usage : ./bench [max_threads]
+
+#include "bench_util.h"
+#include "../atomic_shared_pointers/packed_split_ref_cnt.h"
+#include "../concurrent_data_structures/ms_queue/lock_free_with_asp.h"
+#include "../concurrent_data_structures/treiber_stack/stl_lock_free_stack_cpp20.h"
+#include "../atomic_shared_pointers/hazard_ptr_asp.h"
+
+constexpr std::size_t ops_per_thread = 100'000;
+
+// x : per-thread rng state, returns a value in [0, 100)
+inline unsigned dice(std::uint64_t &x)
+{
+    x = x * 6364136223846793005ull + 1442695040888963407ull;
+    return static_cast<unsigned>((x >> 33) % 100);
+}
+
+template <typename P>
+void atomic_workload(const char *name, unsigned threads, unsigned store_percent)
+{
+    typename P::template atomic_shared<std::uint64_t> a{P::template make<std::uint64_t>(0)};
+    bench::latencies lat{threads, ops_per_thread};
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        std::uint64_t x = i + 1, sink = 0;
+        for (std::size_t n = 0; n < ops_per_thread; ++n)
+        {
+            if (dice(x) < store_percent)
+                lat.time(i, [&] { a.store(P::template make<std::uint64_t>(n)); });
+            else
+                lat.time(i, [&] { sink += *a.load(); });
+        }
+        if (sink == 42) // keep loads alive
+            std::printf(" "); });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+    lat.report();
+}
+
+// Same as load-heavy on asp::atomic_shared_ptr, reads through get_snapshot() (no ref count traffic)
+void snapshot_workload(const char *name, unsigned threads, unsigned store_percent)
+{
+    asp::atomic_shared_ptr<std::uint64_t> a{asp::shared_ptr<std::uint64_t>(new std::uint64_t{0})};
+    bench::latencies lat{threads, ops_per_thread};
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        std::uint64_t x = i + 1, sink = 0;
+        for (std::size_t n = 0; n < ops_per_thread; ++n)
+        {
+            if (dice(x) < store_percent)
+                lat.time(i, [&] { a.store(asp::shared_ptr<std::uint64_t>(new std::uint64_t{n})); });
+            else
+                lat.time(i, [&] { sink += *a.get_snapshot(); });
+        }
+        if (sink == 42) // keep loads alive
+            std::printf(" "); });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+    lat.report();
+}
+
+template <typename P>
+void stack_workload(const char *name, unsigned threads)
+{
+    lock_free::Stack<std::uint64_t, P> s;
+    bench::latencies lat{threads, ops_per_thread};
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        for (std::size_t n = 0; n < ops_per_thread / 2; ++n)
+        {
+            lat.time(i, [&] { s.push(n); });
+            lat.time(i, [&] { s.pop(); });
+        } });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+    lat.report();
+}
+
+template <typename P>
+void queue_workload(const char *name, unsigned threads)
+{
+    ms_queue::lf_queue<std::uint64_t, std::allocator<std::uint64_t>, P> q;
+    bench::latencies lat{threads, ops_per_thread};
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        for (std::size_t n = 0; n < ops_per_thread / 2; ++n)
+        {
+            lat.time(i, [&] { q.enqueue(n); });
+            lat.time(i, [&] { q.dequeue(); });
+        } });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+    lat.report();
+}
+
+template <typename P>
+void all_workloads(const char *impl, unsigned threads)
+{
+    std::printf("--- %s\n", impl);
+    atomic_workload<P>("load-heavy (95/5)", threads, 5);
+    atomic_workload<P>("store-heavy (5/95)", threads, 95);
+    atomic_workload<P>("mixed (50/50)", threads, 50);
+    stack_workload<P>("treiber stack push/pop", threads);
+    queue_workload<P>("ms queue enq/deq", threads);
+}
+
+int main(int argc, char **argv)
+{
+    std::printf("std::atomic<shared_ptr> lock-free : %d\n", std::atomic<std::shared_ptr<int>>{}.is_lock_free());
+    std::printf("asp::atomic_sp lock-free : %d\n", asp::atomic_sp<int>{}.is_lock_free());
+    static_assert(asp::packed_atomic_sp<int>::is_always_lock_free);
+    for (auto n : bench::thread_counts(bench::max_threads(argc, argv)))
+    {
+        std::printf("=== threads=%u\n", n);
+        all_workloads<asp::std_policy>("std::atomic<std::shared_ptr>", n);
+        all_workloads<asp::split_ref_cnt_policy>("asp::atomic_sp", n);
+        all_workloads<asp::packed_split_ref_cnt_policy>("asp::packed_atomic_sp", n);
+        all_workloads<asp::hazard_ptr_policy>("asp::atomic_shared_ptr", n);
+        snapshot_workload("load-heavy (95/5) get_snapshot", n, 5);
+    }
+}
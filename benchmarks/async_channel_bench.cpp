@@ -0,0 +1,148 @@
+// coro::async_channel ping-pong : round trip latency of one item there and one back
+//   inline          both coroutines on one thread, receivers resumed right inside send
+//   two executors   ping and pong on their own threads, each with a small run queue, and the
+//                   channels' resume hook posting the receiver to its thread's queue
+//   lf_queue poll   two plain threads polling ms_queue::lf_queue (yielding between polls)
+//   lf_queue wait   two plain threads on lf_queue::dequeue_wait (spin, then futex)
+
+// g++ -std=c++20 -O2 -pthread async_channel_bench.cpp -latomic
+// Usage : ./bench
+
+#include <chrono>
+#include <coroutine>
+#include "bench_util.h"
+#include "../atomic_shared_pointers/epoch_based_reclamation.h"
+#include "../concurrent_data_structures/coroutines/async_channel.h"
+#include "../concurrent_data_structures/ms_queue/lock_free_with_asp.h"
+
+constexpr std::size_t inline_rounds = 200'000;
+constexpr std::size_t thread_rounds = 20'000;
+
+using clk = std::chrono::steady_clock;
+template <typename T>
+using queue = ms_queue::lf_queue<T, std::allocator<T>, ebr::ebr_policy>;
+
+long long since(clk::time_point start) { return std::chrono::duration_cast<std::chrono::nanoseconds>(clk::now() - start).count(); }
+
+// Fire and forget coroutine, starts suspended so it can be started on the right thread
+struct detached
+{
+    struct promise_type
+    {
+        detached get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+    std::coroutine_handle<> handle;
+};
+
+// One thread resuming whatever is posted to it, a null handle stops it
+struct executor
+{
+    queue<std::coroutine_handle<>> ready;
+    void post(std::coroutine_handle<> h) { ready.enqueue(h); }
+    void run()
+    {
+        while (auto h = ready.dequeue_wait())
+            h.resume();
+    }
+};
+
+struct post_to
+{
+    executor *e;
+    void operator()(std::coroutine_handle<> h) const { e->post(h); }
+};
+
+template <typename Channel>
+detached pong(Channel &in, Channel &out, std::size_t rounds)
+{
+    for (std::size_t i = 0; i < rounds; ++i)
+        co_await out.send(co_await in.receive());
+}
+
+template <typename Channel, typename Done>
+detached ping(Channel &out, Channel &in, std::size_t rounds, bench::latencies &lat, Done done)
+{
+    for (std::size_t i = 0; i < rounds; ++i)
+    {
+        auto start = clk::now();
+        co_await out.send(i);
+        co_await in.receive();
+        lat.record(0, since(start));
+    }
+    done();
+}
+
+void inline_pingpong()
+{
+    coro::async_channel<std::size_t> there, back;
+    bench::latencies lat{1, inline_rounds};
+    auto start = clk::now();
+    pong(there, back, inline_rounds).handle.resume(); // parks on there.receive()
+    ping(there, back, inline_rounds, lat, [] {}).handle.resume();
+    bench::report("channel inline", 1, inline_rounds, since(start) / 1e9);
+    lat.report();
+}
+
+void executor_pingpong()
+{
+    executor ping_exec, pong_exec;
+    // receivers of `there` are pong's, of `back` ping's
+    coro::async_channel<std::size_t, post_to> there{post_to{&pong_exec}}, back{post_to{&ping_exec}};
+    bench::latencies lat{1, thread_rounds};
+    pong_exec.post(pong(there, back, thread_rounds).handle);
+    ping_exec.post(ping(there, back, thread_rounds, lat, [&]
+                        { ping_exec.post({}); pong_exec.post({}); })
+                       .handle);
+    auto start = clk::now();
+    std::thread t1{[&]
+                   { ping_exec.run(); }};
+    std::thread t2{[&]
+                   { pong_exec.run(); }};
+    t1.join();
+    t2.join();
+    bench::report("channel two executors", 2, thread_rounds, since(start) / 1e9);
+    lat.report();
+}
+
+// Plain threads on two lf_queues, Take(queue) blocks or polls until it gets an item
+template <typename Take>
+void queue_pingpong(const char *name, Take take)
+{
+    queue<std::size_t> there, back;
+    bench::latencies lat{1, thread_rounds};
+    auto start = clk::now();
+    std::thread pong_thread{[&]
+                            {
+        for (std::size_t i = 0; i < thread_rounds; ++i)
+            back.enqueue(take(there)); }};
+    for (std::size_t i = 0; i < thread_rounds; ++i)
+    {
+        auto t = clk::now();
+        there.enqueue(i);
+        take(back);
+        lat.record(0, since(t));
+    }
+    pong_thread.join();
+    bench::report(name, 2, thread_rounds, since(start) / 1e9);
+    lat.report();
+}
+
+int main()
+{
+    inline_pingpong();
+    executor_pingpong();
+    queue_pingpong("lf_queue poll", [](queue<std::size_t> &q)
+                   {
+        while (true)
+        {
+            if (auto v = q.dequeue())
+                return *v;
+            std::this_thread::yield();
+        } });
+    queue_pingpong("lf_queue wait", [](queue<std::size_t> &q)
+                   { return q.dequeue_wait(); });
+}
@@ -0,0 +1,124 @@
+// Small helpers shared by the benchmarks in this directory
+// Build any benchmark standalone, e.g. :
+//     g++ -std=c++20 -O2 -pthread elimination_stack_bench.cpp -o bench
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+namespace bench
+{
+    // Thread counts to sweep : 1, 2, 4, ... up to max (max itself always included)
+    inline std::vector<unsigned> thread_counts(unsigned max)
+    {
+        std::vector<unsigned> counts;
+        for (unsigned n = 1; n < max; n *= 2)
+            counts.push_back(n);
+        counts.push_back(max);
+        return counts;
+    }
+
+    // Max thread count from argv[1], defaults to twice the hardware threads
+    inline unsigned max_threads(int argc, char **argv)
+    {
+        if (argc > 1)
+            return static_cast<unsigned>(std::atoi(argv[1]));
+        auto hw = std::thread::hardware_concurrency();
+        return hw ? 2 * hw : 8;
+    }
+
+    // Runs fn(thread_idx) on n threads released together
+    // Returns wall clock seconds from release till the last thread finishes
+    template <typename F>
+    double run_threads(unsigned n, F fn)
+    {
+        std::atomic<bool> go{false};
+        std::atomic<unsigned> ready{0};
+        std::vector<std::thread> threads;
+        threads.reserve(n);
+        for (unsigned i = 0; i < n; ++i)
+            threads.emplace_back([&, i]
+                                 {
+                ready.fetch_add(1);
+                while (!go.load())
+                    std::this_thread::yield();
+                fn(i); });
+        while (ready.load() != n)
+            std::this_thread::yield();
+        auto start = std::chrono::steady_clock::now();
+        go.store(true);
+        for (auto &t : threads)
+            t.join();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Pins the calling thread to core (mod the no of cores), returns false where unsupported
+    inline bool pin_to_core(unsigned core)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core % std::max(1u, std::thread::hardware_concurrency()), &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0;
+#else
+        (void)core;
+        return false;
+#endif
+    }
+
+    inline void report(const char *name, unsigned threads, std::size_t ops, double secs)
+    {
+        std::printf("%-28s threads=%-4u %10.3f Mops/s\n", name, threads, ops / secs / 1e6);
+    }
+
+    // Per-thread latency samples in nanoseconds, merged for percentiles after the run
+    class latencies
+    {
+        std::vector<std::vector<std::uint32_t>> per_thread;
+
+    public:
+        latencies(unsigned threads, std::size_t reserve) : per_thread(threads)
+        {
+            for (auto &v : per_thread)
+                v.reserve(reserve);
+        }
+
+        // Times fn() and records it for thread i
+        template <typename F>
+        void time(unsigned i, F &&fn)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            record(i, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        // Records a sample measured elsewhere
+        void record(unsigned i, long long ns)
+        {
+            per_thread[i].push_back(static_cast<std::uint32_t>(std::clamp<long long>(ns, 0, UINT32_MAX)));
+        }
+
+        void report() const
+        {
+            std::vector<std::uint32_t> all;
+            for (auto &v : per_thread)
+                all.insert(all.end(), v.begin(), v.end());
+            if (all.empty())
+                return;
+            std::sort(all.begin(), all.end());
+            auto pct = [&](double p)
+            { return all[static_cast<std::size_t>(p * (all.size() - 1))]; };
+            std::printf("%-28s p50=%uns p99=%uns p999=%uns max=%uns\n", "", pct(0.5), pct(0.99), pct(0.999), all.back());
+        }
+    };
+}
@@ -0,0 +1,69 @@
+// Optimistic cuckoo hashing : hash_table::cuckoo_map vs std::unordered_map behind a std::shared_mutex
+// 90 / 10 and 50 / 50 find / (insert + erase) mixes over a prefilled table
+// Usage : ./bench [max_threads]
+
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include "bench_util.h"
+#include "../concurrent_data_structures/hash_table/cuckoo_map.h"
+
+constexpr std::size_t keys = 1 << 16;
+constexpr std::size_t ops_per_thread = 200'000;
+
+struct locked_map
+{
+    std::unordered_map<std::size_t, std::size_t> map;
+    std::shared_mutex m;
+    bool insert(std::size_t k, std::size_t v)
+    {
+        std::unique_lock lk{m};
+        return map.emplace(k, v).second;
+    }
+    bool erase(std::size_t k)
+    {
+        std::unique_lock lk{m};
+        return map.erase(k);
+    }
+    bool contains(std::size_t k)
+    {
+        std::shared_lock lk{m};
+        return map.count(k);
+    }
+};
+
+template <typename Map>
+void run(const char *name, unsigned threads, unsigned write_percent)
+{
+    Map map;
+    for (std::size_t k = 0; k < keys; k += 2) // half full so inserts and erases both succeed
+        map.insert(k, k);
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        std::size_t x = i * 7919 + 1;
+        for (std::size_t n = 0; n < ops_per_thread; ++n)
+        {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+            auto k = (x >> 33) % keys;
+            auto dice = (x >> 20) % 100;
+            if (dice < write_percent / 2)
+                map.insert(k, k);
+            else if (dice < write_percent)
+                map.erase(k);
+            else
+                map.contains(k);
+        } });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+}
+
+int main(int argc, char **argv)
+{
+    using cuckoo = hash_table::cuckoo_map<std::size_t, std::size_t>;
+    for (auto n : bench::thread_counts(bench::max_threads(argc, argv)))
+    {
+        run<cuckoo>("cuckoo 90/10", n, 10);
+        run<locked_map>("locked 90/10", n, 10);
+        run<cuckoo>("cuckoo 50/50", n, 50);
+        run<locked_map>("locked 50/50", n, 50);
+    }
+}
@@ -0,0 +1,32 @@
+// Throughput of lock_free::Stack vs lock_free::EliminationStack as threads grow
+// Each thread alternates push and pop, the worst case for a single head
+// Usage : ./bench [max_threads]
+
+#include "bench_util.h"
+#include "../concurrent_data_structures/treiber_stack/elimination_backoff_stack.h"
+
+constexpr std::size_t ops_per_thread = 200'000;
+
+template <typename S>
+void run(const char *name, unsigned threads, S &stack)
+{
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        for (std::size_t k = 0; k < ops_per_thread / 2; ++k)
+        {
+            stack.push(static_cast<int>(i + k));
+            stack.pop();
+        } });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+}
+
+int main(int argc, char **argv)
+{
+    for (auto n : bench::thread_counts(bench::max_threads(argc, argv)))
+    {
+        lock_free::Stack<int> plain;
+        run("treiber", n, plain);
+        lock_free::EliminationStack<int> elim{n / 2 + 1};
+        run("elimination", n, elim);
+    }
+}
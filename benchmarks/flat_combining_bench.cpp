@@ -0,0 +1,102 @@
+// Flat combining against lock-free and plain locked versions of the same structure, 1 .. 64 threads
+//   stack : lock_free::Stack (epochs), flat_combining::fc_stack, std::vector + std::mutex
+//   queue : ms_queue::lf_queue (epochs), flat_combining::fc_queue, std::deque + std::mutex
+// Every thread runs push / pop (enqueue / dequeue) pairs, so all of them hit the same ends.
+// Pick a structure per contention level from where the curves cross.
+
+// g++ -std=c++20 -O2 -pthread flat_combining_bench.cpp -latomic
+// Usage : ./bench [max_threads]   (defaults to 64)
+
+#include <deque>
+#include <mutex>
+#include <optional>
+#include "bench_util.h"
+#include "../atomic_shared_pointers/epoch_based_reclamation.h"
+#include "../concurrent_data_structures/flat_combining/fc_queue.h"
+#include "../concurrent_data_structures/flat_combining/fc_stack.h"
+#include "../concurrent_data_structures/ms_queue/lock_free_with_asp.h"
+#include "../concurrent_data_structures/treiber_stack/stl_lock_free_stack_cpp20.h"
+
+constexpr std::size_t ops_per_thread = 100'000;
+
+struct locked_stack
+{
+    std::vector<std::uint64_t> items;
+    std::mutex m;
+    void push(std::uint64_t v)
+    {
+        std::lock_guard lk{m};
+        items.push_back(v);
+    }
+    std::optional<std::uint64_t> pop()
+    {
+        std::lock_guard lk{m};
+        if (items.empty())
+            return {};
+        auto v = items.back();
+        items.pop_back();
+        return v;
+    }
+};
+
+struct locked_queue
+{
+    std::deque<std::uint64_t> items;
+    std::mutex m;
+    void enqueue(std::uint64_t v)
+    {
+        std::lock_guard lk{m};
+        items.push_back(v);
+    }
+    std::optional<std::uint64_t> dequeue()
+    {
+        std::lock_guard lk{m};
+        if (items.empty())
+            return {};
+        auto v = items.front();
+        items.pop_front();
+        return v;
+    }
+};
+
+template <typename S>
+void stack_pairs(const char *name, unsigned threads)
+{
+    S s;
+    auto secs = bench::run_threads(threads, [&](unsigned)
+                                   {
+        for (std::size_t n = 0; n < ops_per_thread / 2; ++n)
+        {
+            s.push(n);
+            s.pop();
+        } });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+}
+
+template <typename Q>
+void queue_pairs(const char *name, unsigned threads)
+{
+    Q q;
+    auto secs = bench::run_threads(threads, [&](unsigned)
+                                   {
+        for (std::size_t n = 0; n < ops_per_thread / 2; ++n)
+        {
+            q.enqueue(n);
+            q.dequeue();
+        } });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+}
+
+int main(int argc, char **argv)
+{
+    auto max = argc > 1 ? bench::max_threads(argc, argv) : 64u;
+    for (auto n : bench::thread_counts(max))
+    {
+        stack_pairs<lock_free::Stack<std::uint64_t, ebr::ebr_policy>>("treiber stack (epochs)", n);
+        stack_pairs<flat_combining::fc_stack<std::uint64_t>>("fc_stack", n);
+        stack_pairs<locked_stack>("vector + mutex", n);
+        queue_pairs<ms_queue::lf_queue<std::uint64_t, std::allocator<std::uint64_t>, ebr::ebr_policy>>("ms queue (epochs)", n);
+        queue_pairs<flat_combining::fc_queue<std::uint64_t>>("fc_queue", n);
+        queue_pairs<locked_queue>("deque + mutex", n);
+    }
+}
@@ -0,0 +1,55 @@
+// Cost of the in-tree hazard pointer domain (hazard_pointers.h) under load
+// Every thread keeps swapping a fresh object into one shared slot and retiring the old one,
+// while also protecting and reading the current object. Reports retire throughput (scans
+// included), average cost per retire, and the peak no of retired but unreclaimed objects.
+// Usage : ./bench [max_threads]
+
+#include "bench_util.h"
+#include "../atomic_shared_pointers/hazard_pointers.h"
+
+constexpr std::size_t ops_per_thread = 200'000;
+
+struct payload : hazptr::hazptr_obj_base<payload>
+{
+    std::size_t value[8]{}; // a cache line worth of data
+    explicit payload(std::size_t v) { value[0] = v; }
+};
+
+void run(unsigned threads, unsigned reads_per_retire)
+{
+    std::atomic<payload *> slot{new payload{0}};
+    auto &domain = hazptr::default_domain();
+    domain.reset_peak();
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        auto hp = hazptr::make_hazard_pointer();
+        std::size_t sink = 0;
+        for (std::size_t n = 0; n < ops_per_thread; ++n)
+        {
+            for (unsigned r = 0; r < reads_per_retire; ++r)
+            {
+                sink += hp.protect(slot)->value[0];
+                hp.reset_protection();
+            }
+            slot.exchange(new payload{i + n})->retire();
+        }
+        if (sink == 42)
+            std::printf(" "); });
+    char name[64];
+    std::snprintf(name, sizeof name, "retire, %u reads each", reads_per_retire);
+    bench::report(name, threads, threads * ops_per_thread, secs);
+    std::printf("%-28s %.1f thread-ns per op, peak unreclaimed %zu objects (%zu bytes)\n", "",
+                secs * 1e9 * threads / (threads * ops_per_thread), domain.peak_unreclaimed_count(),
+                domain.peak_unreclaimed_count() * sizeof(payload));
+    slot.load()->retire();
+    domain.reclaim_all();
+}
+
+int main(int argc, char **argv)
+{
+    for (auto n : bench::thread_counts(bench::max_threads(argc, argv)))
+    {
+        run(n, 0);
+        run(n, 4);
+    }
+}
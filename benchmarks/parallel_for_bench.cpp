@@ -0,0 +1,69 @@
+// Fork-join scaling of work_stealing::thread_pool::parallel_for with the no of workers
+//   uniform    every index costs the same
+//   skewed     index i costs ~ i, so static partitioning leaves most threads idle at the end
+// Each workload also runs serially and with static partitioning (one contiguous block per
+// std::thread) for reference. Reports Mitems/s and speedup over the serial loop.
+// Usage : ./bench [max_workers]   (defaults to the no of hardware threads)
+
+#include <cmath>
+#include <vector>
+#include "bench_util.h"
+#include "../concurrent_data_structures/work_stealing/thread_pool.h"
+
+constexpr std::size_t items = 1 << 16;
+constexpr std::size_t grain = 64;
+
+// ~cost rounds of dependent float math, the result goes to out so it can't be dropped
+inline void work(std::vector<double> &out, std::size_t i, std::size_t cost)
+{
+    double x = static_cast<double>(i) + 1;
+    for (std::size_t k = 0; k < cost; ++k)
+        x = std::sqrt(x + static_cast<double>(k));
+    out[i] = x;
+}
+
+template <typename Cost>
+void workload(const char *name, std::vector<unsigned> &counts, Cost cost)
+{
+    std::vector<double> out(items);
+    auto body = [&](std::size_t i)
+    { work(out, i, cost(i)); };
+
+    std::printf("--- %s\n", name);
+    auto serial = bench::run_threads(1, [&](unsigned)
+                                     {
+        for (std::size_t i = 0; i < items; ++i)
+            body(i); });
+    bench::report("serial", 1, items, serial);
+
+    for (auto n : counts)
+    {
+        auto secs = bench::run_threads(n, [&](unsigned t)
+                                       {
+            auto lo = items * t / n, hi = items * (t + 1) / n;
+            for (auto i = lo; i < hi; ++i)
+                body(i); });
+        bench::report("static partition", n, items, secs);
+        std::printf("%-28s speedup %.2fx\n", "", serial / secs);
+    }
+
+    for (auto n : counts)
+    {
+        work_stealing::thread_pool pool{n};
+        pool.parallel_for(0, items, grain, body); // warm up : threads started, deques touched
+        auto secs = bench::run_threads(1, [&](unsigned)
+                                       { pool.parallel_for(0, items, grain, body); });
+        bench::report("work stealing", n, items, secs);
+        std::printf("%-28s speedup %.2fx\n", "", serial / secs);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    auto hw = std::max(1u, std::thread::hardware_concurrency());
+    auto counts = bench::thread_counts(argc > 1 ? bench::max_threads(argc, argv) : hw);
+    workload("uniform", counts, [](std::size_t)
+             { return std::size_t{200}; });
+    workload("skewed", counts, [](std::size_t i)
+             { return 400 * i / items; });
+}
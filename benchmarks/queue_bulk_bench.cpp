@@ -0,0 +1,57 @@
+// ms_queue::lf_queue one element at a time vs enqueue_bulk / dequeue_bulk
+// Every thread pushes a burst of `batch` items then pops as many, over and over.
+// Usage : ./bench [max_threads]
+
+#include <array>
+#include "bench_util.h"
+#include "../concurrent_data_structures/ms_queue/lock_free_with_asp.h"
+
+constexpr std::size_t ops_per_thread = 200'000; // items enqueued (and dequeued) per thread
+
+template <std::size_t Batch>
+void run(unsigned threads)
+{
+    char name[64];
+    {
+        ms_queue::lf_queue<std::uint64_t> q;
+        auto secs = bench::run_threads(threads, [&](unsigned)
+                                       {
+            for (std::size_t n = 0; n < ops_per_thread; n += Batch)
+            {
+                for (std::size_t i = 0; i < Batch; ++i)
+                    q.enqueue(n + i);
+                for (std::size_t i = 0; i < Batch; ++i)
+                    q.dequeue();
+            } });
+        std::snprintf(name, sizeof name, "single    batch=%zu", Batch);
+        bench::report(name, threads, 2 * threads * ops_per_thread, secs);
+    }
+    {
+        ms_queue::lf_queue<std::uint64_t> q;
+        auto secs = bench::run_threads(threads, [&](unsigned)
+                                       {
+            std::array<std::uint64_t, Batch> in{}, out{};
+            for (std::size_t n = 0; n < ops_per_thread; n += Batch)
+            {
+                for (std::size_t i = 0; i < Batch; ++i)
+                    in[i] = n + i;
+                q.enqueue_bulk(in.begin(), in.end());
+                // may come back short when others got there first, the queue evens out over the run
+                for (std::size_t got = 0, tries = 0; got < Batch && tries < Batch; ++tries)
+                    got += q.dequeue_bulk(out.begin(), Batch - got);
+            } });
+        std::snprintf(name, sizeof name, "bulk      batch=%zu", Batch);
+        bench::report(name, threads, 2 * threads * ops_per_thread, secs);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    for (auto n : bench::thread_counts(bench::max_threads(argc, argv)))
+    {
+        std::printf("=== threads=%u\n", n);
+        run<1>(n);
+        run<8>(n);
+        run<64>(n);
+    }
+}
@@ -0,0 +1,75 @@
+// ms_queue::lf_queue with std::allocator vs lock_free::pool_allocator
+// Counts calls into the global allocator during a steady-state run (after warm-up passes)
+// Note : a preempted thread holding an old node keeps every later node alive through the
+// next pointers, so when threads are oversubscribed the pool may still grow by a few slabs.
+// Usage : ./bench [max_threads]
+
+#include <cstdio>
+#include <new>
+#include "bench_util.h"
+#include "../concurrent_data_structures/pool_allocator.h"
+#include "../concurrent_data_structures/ms_queue/lock_free_with_asp.h"
+
+static std::atomic<std::size_t> allocator_calls{0};
+
+void *operator new(std::size_t n)
+{
+    allocator_calls.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(n))
+        return p;
+    throw std::bad_alloc{};
+}
+void *operator new(std::size_t n, std::align_val_t a)
+{
+    allocator_calls.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::aligned_alloc(static_cast<std::size_t>(a), (n + static_cast<std::size_t>(a) - 1) / static_cast<std::size_t>(a) * static_cast<std::size_t>(a)))
+        return p;
+    throw std::bad_alloc{};
+}
+void operator delete(void *p) noexcept
+{
+    allocator_calls.fetch_add(1, std::memory_order_relaxed);
+    std::free(p);
+}
+void operator delete(void *p, std::size_t) noexcept { operator delete(p); }
+void operator delete(void *p, std::align_val_t) noexcept { operator delete(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { operator delete(p); }
+
+constexpr std::size_t ops_per_thread = 200'000;
+
+template <typename Q>
+double pass(Q &q, unsigned threads)
+{
+    return bench::run_threads(threads, [&](unsigned i)
+                              {
+        for (std::size_t k = 0; k < ops_per_thread / 2; ++k)
+        {
+            q.enqueue(static_cast<int>(i + k));
+            q.dequeue();
+        } });
+}
+
+template <typename Q>
+void run(const char *name, unsigned threads)
+{
+    Q q;
+    for (int i = 0; i < 3; ++i) // warm-up : fills the pool
+        pass(q, threads);
+    auto before = allocator_calls.load();
+    bench::run_threads(threads, [](unsigned) {});
+    auto thread_overhead = allocator_calls.load() - before; // std::thread bookkeeping, not the queue's
+    before = allocator_calls.load();
+    auto secs = pass(q, threads);
+    auto calls = allocator_calls.load() - before - thread_overhead;
+    bench::report(name, threads, threads * ops_per_thread, secs);
+    std::printf("%-28s allocator calls in steady state : %zu\n", "", calls);
+}
+
+int main(int argc, char **argv)
+{
+    for (auto n : bench::thread_counts(bench::max_threads(argc, argv)))
+    {
+        run<ms_queue::lf_queue<int>>("lf_queue std::allocator", n);
+        run<ms_queue::lf_queue<int, lock_free::pool_allocator<int>>>("lf_queue pool_allocator", n);
+    }
+}
@@ -0,0 +1,78 @@
+// Memory reclamation schemes head to head on the same algorithms :
+//   reference counting                    asp::std_policy, asp::packed_split_ref_cnt_policy
+//   intrusive reference counting          asp::intrusive_policy (count in the node, no ctrl block)
+//   hazard pointers (on ctrl blocks)      asp::hazard_ptr_policy
+//   epoch based reclamation               ebr::ebr_policy
+// lock_free::Stack and ms_queue::lf_queue push / pop pairs with each policy swapped in.
+// Reports throughput and per-op latency percentiles for 1 .. max threads.
+
+// g++ -std=c++20 -O2 -pthread reclamation_bench.cpp -latomic
+// Add -DLF_CONTENTION_STATS for CAS failure / retry / helping counts after each policy
+// (contention_stats.h), they cost a bit of throughput themselves.
+// Usage : ./bench [max_threads]
+
+#include "bench_util.h"
+#include "../atomic_shared_pointers/epoch_based_reclamation.h"
+#include "../atomic_shared_pointers/hazard_ptr_asp.h"
+#include "../atomic_shared_pointers/intrusive_ptr.h"
+#include "../atomic_shared_pointers/packed_split_ref_cnt.h"
+#include "../concurrent_data_structures/ms_queue/lock_free_with_asp.h"
+#include "../concurrent_data_structures/treiber_stack/stl_lock_free_stack_cpp20.h"
+
+constexpr std::size_t ops_per_thread = 200'000;
+
+template <typename P>
+void stack_workload(const char *name, unsigned threads)
+{
+    lock_free::Stack<std::uint64_t, P> s;
+    bench::latencies lat{threads, ops_per_thread};
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        for (std::size_t n = 0; n < ops_per_thread / 2; ++n)
+        {
+            lat.time(i, [&] { s.push(n); });
+            lat.time(i, [&] { s.pop(); });
+        } });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+    lat.report();
+}
+
+template <typename P>
+void queue_workload(const char *name, unsigned threads)
+{
+    ms_queue::lf_queue<std::uint64_t, std::allocator<std::uint64_t>, P> q;
+    bench::latencies lat{threads, ops_per_thread};
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        for (std::size_t n = 0; n < ops_per_thread / 2; ++n)
+        {
+            lat.time(i, [&] { q.enqueue(n); });
+            lat.time(i, [&] { q.dequeue(); });
+        } });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+    lat.report();
+}
+
+template <typename P>
+void both(const char *impl, unsigned threads)
+{
+    std::printf("--- %s\n", impl);
+    contention::reset();
+    stack_workload<P>("treiber stack push/pop", threads);
+    queue_workload<P>("ms queue enq/deq", threads);
+    if constexpr (contention::enabled)
+        contention::dump();
+}
+
+int main(int argc, char **argv)
+{
+    for (auto n : bench::thread_counts(bench::max_threads(argc, argv)))
+    {
+        std::printf("=== threads=%u\n", n);
+        both<asp::std_policy>("refcount : std::atomic<std::shared_ptr>", n);
+        both<asp::packed_split_ref_cnt_policy>("refcount : asp::packed_atomic_sp", n);
+        both<asp::intrusive_policy>("refcount : asp::atomic_intrusive_ptr", n);
+        both<asp::hazard_ptr_policy>("hazard pointers : asp::atomic_shared_ptr", n);
+        both<ebr::ebr_policy>("epochs : ebr::ebr_policy", n);
+    }
+}
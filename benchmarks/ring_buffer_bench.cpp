@@ -0,0 +1,87 @@
+// Producer / consumer throughput : ms_queue::lf_queue vs segmented_queue::faa_array_queue vs
+// ring_buffer::mpmc_ring (single and bulk ops)
+// Half of the threads produce, half consume, every item is handed over exactly once
+// Usage : ./bench [max_threads]
+
+#include <algorithm>
+#include <vector>
+#include "bench_util.h"
+#include "../concurrent_data_structures/ms_queue/lock_free_with_asp.h"
+#include "../concurrent_data_structures/ring_buffer/mpmc_ring_buffer.h"
+#include "../concurrent_data_structures/segmented_queue/faa_array_queue.h"
+
+constexpr std::size_t items_per_producer = 200'000;
+constexpr std::size_t batch = 16;
+
+// put(k) / take() return how many items they moved, 0 means full / empty and is retried
+// after yielding (matters when threads outnumber cores)
+template <typename Put, typename Take>
+void run(const char *name, unsigned threads, Put put, Take take)
+{
+    unsigned producers = std::max(1u, threads / 2);
+    std::size_t total = producers * items_per_producer;
+    std::atomic<std::size_t> consumed{0};
+    auto secs = bench::run_threads(2 * producers, [&](unsigned i)
+                                   {
+        if (i < producers)
+        {
+            for (std::size_t k = 0; k < items_per_producer;)
+            {
+                auto moved = put(k);
+                if (!moved)
+                    std::this_thread::yield();
+                k += moved;
+            }
+        }
+        else
+        {
+            while (consumed.load(std::memory_order_relaxed) < total)
+            {
+                auto moved = take();
+                if (!moved)
+                    std::this_thread::yield();
+                consumed.fetch_add(moved, std::memory_order_relaxed);
+            }
+        } });
+    bench::report(name, 2 * producers, total, secs);
+}
+
+int main(int argc, char **argv)
+{
+    for (auto n : bench::thread_counts(bench::max_threads(argc, argv)))
+    {
+        if (n < 2)
+            continue;
+        {
+            ms_queue::lf_queue<std::size_t> q;
+            run("lf_queue", n, [&](std::size_t k)
+                { q.enqueue(k); return std::size_t{1}; }, [&]
+                { return std::size_t{q.dequeue().has_value()}; });
+        }
+        {
+            segmented_queue::faa_array_queue<std::size_t> q;
+            run("faa_array_queue", n, [&](std::size_t k)
+                { q.enqueue(k); return std::size_t{1}; }, [&]
+                { return std::size_t{q.dequeue().has_value()}; });
+        }
+        {
+            ring_buffer::mpmc_ring<std::size_t> q{1024};
+            run("mpmc_ring", n, [&](std::size_t k)
+                { return std::size_t{q.try_enqueue(k)}; }, [&]
+                { return std::size_t{q.try_dequeue().has_value()}; });
+        }
+        {
+            ring_buffer::mpmc_ring<std::size_t> q{1024};
+            run("mpmc_ring bulk", n, [&](std::size_t k)
+                {
+                    std::size_t items[batch];
+                    auto n = std::min(batch, items_per_producer - k);
+                    for (std::size_t i = 0; i < n; ++i)
+                        items[i] = k + i;
+                    return q.try_enqueue_bulk(items, n); }, [&]
+                {
+                    std::size_t items[batch];
+                    return q.try_dequeue_bulk(items, batch); });
+        }
+    }
+}
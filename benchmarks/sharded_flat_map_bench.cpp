@@ -0,0 +1,127 @@
+// hash_table::sharded_flat_map : insert scaling and peak memory while growing
+//   fill      every thread inserts its own range of keys into an empty map (no reserve), so the
+//             table grows all the way. Reports throughput and the peak of live heap bytes.
+//   90/10     find / (insert + erase) mix over a prefilled map
+// Against the same map with a single submap (one mutex, one big table) and std::unordered_map
+// behind a mutex. Build with -mavx2 for 32 byte groups, the default is SSE2 (16).
+// Usage : ./bench [max_threads]
+
+#include <malloc.h>
+#include <mutex>
+#include <unordered_map>
+#include "bench_util.h"
+#include "../concurrent_data_structures/hash_table/sharded_flat_map.h"
+
+// Live heap bytes and their high-water mark, via replaced global operator new / delete
+namespace heap
+{
+    std::atomic<std::size_t> live{0}, peak{0};
+
+    void *note(void *p)
+    {
+        if (!p)
+            throw std::bad_alloc{};
+        auto n = live.fetch_add(malloc_usable_size(p)) + malloc_usable_size(p);
+        auto top = peak.load();
+        while (n > top && !peak.compare_exchange_weak(top, n))
+            ;
+        return p;
+    }
+    void drop(void *p)
+    {
+        if (p)
+            live.fetch_sub(malloc_usable_size(p));
+        std::free(p);
+    }
+    void reset_peak() { peak.store(live.load()); }
+}
+
+void *operator new(std::size_t n) { return heap::note(std::malloc(n)); }
+void *operator new(std::size_t n, std::align_val_t a) { return heap::note(std::aligned_alloc(static_cast<std::size_t>(a), (n + static_cast<std::size_t>(a) - 1) & ~(static_cast<std::size_t>(a) - 1))); }
+void operator delete(void *p) noexcept { heap::drop(p); }
+void operator delete(void *p, std::size_t) noexcept { heap::drop(p); }
+void operator delete(void *p, std::align_val_t) noexcept { heap::drop(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { heap::drop(p); }
+
+constexpr std::size_t keys_per_thread = 500'000;
+constexpr std::size_t keys = 1 << 16;
+constexpr std::size_t ops_per_thread = 200'000;
+
+struct locked_map
+{
+    std::unordered_map<std::size_t, std::size_t> map;
+    std::mutex m;
+    bool insert(std::size_t k, std::size_t v)
+    {
+        std::lock_guard lk{m};
+        return map.emplace(k, v).second;
+    }
+    bool erase(std::size_t k)
+    {
+        std::lock_guard lk{m};
+        return map.erase(k);
+    }
+    bool contains(std::size_t k)
+    {
+        std::lock_guard lk{m};
+        return map.count(k);
+    }
+};
+
+template <typename Map>
+void fill(const char *name, unsigned threads)
+{
+    heap::reset_peak();
+    auto base = heap::live.load();
+    std::size_t final_bytes;
+    {
+        Map map;
+        auto t = bench::run_threads(threads, [&](unsigned i)
+                                    {
+            for (std::size_t k = 0; k < keys_per_thread; ++k)
+                map.insert(i * keys_per_thread + k, k); });
+        bench::report(name, threads, threads * keys_per_thread, t);
+        final_bytes = heap::live.load() - base;
+    }
+    std::printf("%-28s final %.1f MB, peak %.1f MB\n", "", final_bytes / 1e6, (heap::peak.load() - base) / 1e6);
+}
+
+template <typename Map>
+void mixed(const char *name, unsigned threads)
+{
+    Map map;
+    for (std::size_t k = 0; k < keys; k += 2) // half full so inserts and erases both succeed
+        map.insert(k, k);
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        std::size_t x = i * 7919 + 1;
+        for (std::size_t n = 0; n < ops_per_thread; ++n)
+        {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+            auto k = (x >> 33) % keys;
+            auto dice = (x >> 20) % 100;
+            if (dice < 5)
+                map.insert(k, k);
+            else if (dice < 10)
+                map.erase(k);
+            else
+                map.contains(k);
+        } });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+}
+
+int main(int argc, char **argv)
+{
+    using sharded = hash_table::sharded_flat_map<std::size_t, std::size_t>;   // 16 submaps
+    using single = hash_table::sharded_flat_map<std::size_t, std::size_t, 0>; // 1 submap
+    std::printf("group width %zu\n", hash_table::swiss::group::width);
+    for (auto n : bench::thread_counts(bench::max_threads(argc, argv)))
+    {
+        fill<sharded>("sharded fill", n);
+        fill<single>("single submap fill", n);
+        fill<locked_map>("locked unordered_map fill", n);
+        mixed<sharded>("sharded 90/10", n);
+        mixed<single>("single submap 90/10", n);
+        mixed<locked_map>("locked unordered_map 90/10", n);
+    }
+}
@@ -0,0 +1,78 @@
+// roopam::shd_ptr vs std::shared_ptr : cost of create / copy / destroy, single threaded
+//   create+destroy   make_shared, and allocate_shared with lock_free::pool_allocator
+//   copy+destroy     copy an existing pointer and drop the copy (ref count inc / dec),
+//                    also with roopam's nonatomic_count and biased_count policies (from the
+//                    owner thread, and from another thread which falls back to atomics)
+// Usage : ./bench
+
+#include "bench_util.h"
+#include "../concurrent_data_structures/pool_allocator.h"
+#include "../smart_pointers_impl/shared_ptr_ctrl_blk.h"
+
+constexpr std::size_t ops = 5'000'000;
+
+struct payload
+{
+    std::uint64_t a{}, b{};
+    payload() = default;
+    payload(std::uint64_t x) : a{x}, b{x} {}
+};
+
+// keeps the optimizer from dropping the work
+template <typename P>
+void use(const P &p)
+{
+    asm volatile("" : : "r"(&p) : "memory");
+}
+
+template <typename F>
+void run(const char *name, F fn)
+{
+    auto secs = bench::run_threads(1, [&](unsigned)
+                                   {
+        for (std::size_t i = 0; i < ops; ++i)
+            fn(i); });
+    bench::report(name, 1, ops, secs);
+}
+
+int main()
+{
+    std::printf("roopam : ctrl block header %zu bytes, make_shared block for a %zu byte payload %zu bytes\n",
+                sizeof(roopam::ctrl_blk_base<roopam::atomic_count>), sizeof(payload), sizeof(roopam::ctrl_blk_with_storage<payload>));
+
+    std::printf("--- create+destroy\n");
+    run("std::make_shared", [](std::size_t i)
+        { auto p = std::make_shared<payload>(i); use(p); });
+    run("roopam::make_shared", [](std::size_t i)
+        { auto p = roopam::make_shared<payload>(i); use(p); });
+    lock_free::pool_allocator<payload> pool;
+    run("std::allocate_shared pool", [&](std::size_t i)
+        { auto p = std::allocate_shared<payload>(pool, i); use(p); });
+    run("roopam::allocate_shared pool", [&](std::size_t i)
+        { auto p = roopam::allocate_shared<payload>(pool, i); use(p); });
+    run("std::shared_ptr(new)", [](std::size_t i)
+        { std::shared_ptr<payload> p{new payload{i}}; use(p); });
+    run("roopam::shd_ptr(new)", [](std::size_t i)
+        { roopam::shd_ptr<payload> p{new payload{i}}; use(p); });
+
+    std::printf("--- copy+destroy\n");
+    auto sp = std::make_shared<payload>(1);
+    run("std::shared_ptr", [&](std::size_t)
+        { auto q = sp; use(q); });
+    auto rp = roopam::make_shared<payload>(1);
+    run("roopam::shd_ptr", [&](std::size_t)
+        { auto q = rp; use(q); });
+    auto np = roopam::make_shared<payload, roopam::nonatomic_count>(1);
+    run("roopam nonatomic_count", [&](std::size_t)
+        { auto q = np; use(q); });
+    // run() works on its own thread : the owner's pointer is created there, the other one here
+    roopam::shd_ptr<payload, roopam::biased_count> owned;
+    run("roopam biased_count owner", [&](std::size_t i)
+        {
+            if (i == 0)
+                owned = roopam::make_shared<payload, roopam::biased_count>(1);
+            auto q = owned; use(q); });
+    auto bp = roopam::make_shared<payload, roopam::biased_count>(1);
+    run("roopam biased_count other", [&](std::size_t)
+        { auto q = bp; use(q); });
+}
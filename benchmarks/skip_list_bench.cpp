@@ -0,0 +1,99 @@
+// Ordered map scaling : skip_list::skip_list_map vs std::map behind a std::shared_mutex
+// Read-only lookups, 90 / 10 find / (insert + erase) mixes, and range scans (lower_bound then
+// the next 16 elements) with 10% writers, over a prefilled map
+// Usage : ./bench [max_threads]
+
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include "bench_util.h"
+#include "../concurrent_data_structures/skip_list/skip_list_map.h"
+
+constexpr std::size_t keys = 1 << 16;
+constexpr std::size_t ops_per_thread = 200'000;
+constexpr std::size_t scan_len = 16;
+
+struct locked_map
+{
+    std::map<std::size_t, std::size_t> map;
+    std::shared_mutex m;
+    bool insert(std::size_t k, std::size_t v)
+    {
+        std::unique_lock lk{m};
+        return map.emplace(k, v).second;
+    }
+    bool erase(std::size_t k)
+    {
+        std::unique_lock lk{m};
+        return map.erase(k);
+    }
+    bool contains(std::size_t k)
+    {
+        std::shared_lock lk{m};
+        return map.count(k);
+    }
+    std::size_t scan(std::size_t k)
+    {
+        std::shared_lock lk{m};
+        std::size_t sum = 0, n = 0;
+        for (auto it = map.lower_bound(k); it != map.end() && n < scan_len; ++it, ++n)
+            sum += it->second;
+        return sum;
+    }
+};
+
+struct lock_free_map
+{
+    skip_list::skip_list_map<std::size_t, std::size_t> map;
+    bool insert(std::size_t k, std::size_t v) { return map.insert(k, v); }
+    bool erase(std::size_t k) { return map.erase(k); }
+    bool contains(std::size_t k) { return map.contains(k); }
+    std::size_t scan(std::size_t k)
+    {
+        std::size_t sum = 0, n = 0;
+        for (auto it = map.lower_bound(k); it != map.end() && n < scan_len; ++it, ++n)
+            sum += it->second;
+        return sum;
+    }
+};
+
+template <typename Map>
+void run(const char *name, unsigned threads, unsigned write_percent, bool scans)
+{
+    Map map;
+    for (std::size_t k = 0; k < keys; k += 2) // half full so inserts and erases both succeed
+        map.insert(k, k);
+    std::atomic<std::size_t> sink{0};
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        std::size_t x = i * 7919 + 1, sum = 0;
+        for (std::size_t n = 0; n < ops_per_thread; ++n)
+        {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+            auto k = (x >> 33) % keys;
+            auto dice = (x >> 20) % 100;
+            if (dice < write_percent / 2)
+                map.insert(k, k);
+            else if (dice < write_percent)
+                map.erase(k);
+            else if (scans)
+                sum += map.scan(k);
+            else
+                sum += map.contains(k);
+        }
+        sink.fetch_add(sum); });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+}
+
+int main(int argc, char **argv)
+{
+    for (auto n : bench::thread_counts(bench::max_threads(argc, argv)))
+    {
+        run<lock_free_map>("skip_list read-only", n, 0, false);
+        run<locked_map>("locked std::map read-only", n, 0, false);
+        run<lock_free_map>("skip_list 90/10", n, 10, false);
+        run<locked_map>("locked std::map 90/10", n, 10, false);
+        run<lock_free_map>("skip_list scan 90/10", n, 10, true);
+        run<locked_map>("locked std::map scan 90/10", n, 10, true);
+    }
+}
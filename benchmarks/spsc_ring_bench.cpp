@@ -0,0 +1,116 @@
+// One producer, one consumer, pinned to cores 0 and 1 : ring_buffer::spsc_ring vs ms_queue::lf_queue
+// Throughput : the producer streams items as fast as the queue takes them (single and bulk ops)
+// Latency : ping-pong over a pair of queues, reports round trip percentiles
+// Usage : ./bench
+
+#include <cstdint>
+#include "bench_util.h"
+#include "../concurrent_data_structures/ms_queue/lock_free_with_asp.h"
+#include "../concurrent_data_structures/ring_buffer/spsc_ring_buffer.h"
+
+constexpr std::size_t items = 2'000'000;
+constexpr std::size_t round_trips = 100'000;
+constexpr std::size_t batch = 32;
+
+// put(k) / take() return how many items they moved, 0 means full / empty and is retried
+// after yielding (matters when both threads share a core)
+template <typename Put, typename Take>
+void throughput(const char *name, Put put, Take take)
+{
+    auto secs = bench::run_threads(2, [&](unsigned i)
+                                   {
+        bench::pin_to_core(i);
+        if (i == 0)
+        {
+            for (std::size_t k = 0; k < items;)
+            {
+                auto moved = put(k);
+                if (!moved)
+                    std::this_thread::yield();
+                k += moved;
+            }
+        }
+        else
+        {
+            for (std::size_t k = 0; k < items;)
+            {
+                auto moved = take();
+                if (!moved)
+                    std::this_thread::yield();
+                k += moved;
+            }
+        } });
+    bench::report(name, 2, items, secs);
+}
+
+// Thread 0 sends k on ping and waits for it back on pong, thread 1 echoes
+template <typename Q, typename Send, typename Recv>
+void ping_pong(const char *name, Q &ping, Q &pong, Send send, Recv recv)
+{
+    bench::latencies lat{1, round_trips};
+    auto wait_recv = [&](Q &q)
+    {
+        std::optional<std::size_t> v;
+        while (!(v = recv(q)))
+            std::this_thread::yield();
+        return *v;
+    };
+    auto secs = bench::run_threads(2, [&](unsigned i)
+                                   {
+        bench::pin_to_core(i);
+        for (std::size_t k = 0; k < round_trips; ++k)
+        {
+            if (i == 0)
+                lat.time(0, [&]
+                         { send(ping, k);
+                           wait_recv(pong); });
+            else
+                send(pong, wait_recv(ping));
+        } });
+    bench::report(name, 2, round_trips, secs);
+    lat.report();
+}
+
+int main()
+{
+    std::printf("--- throughput (items/s)\n");
+    {
+        ring_buffer::spsc_ring<std::size_t> q{1024};
+        throughput("spsc_ring", [&](std::size_t k)
+                   { return std::size_t{q.try_enqueue(k)}; }, [&]
+                   { return std::size_t{q.try_dequeue().has_value()}; });
+    }
+    {
+        ring_buffer::spsc_ring<std::size_t> q{1024};
+        throughput("spsc_ring bulk", [&](std::size_t k)
+                   {
+                       std::size_t buf[batch];
+                       auto n = std::min(batch, items - k);
+                       for (std::size_t i = 0; i < n; ++i)
+                           buf[i] = k + i;
+                       return q.try_enqueue_bulk(buf, n); }, [&]
+                   {
+                       std::size_t buf[batch];
+                       return q.try_dequeue_bulk(buf, batch); });
+    }
+    {
+        ms_queue::lf_queue<std::size_t> q;
+        throughput("lf_queue", [&](std::size_t k)
+                   { q.enqueue(k); return std::size_t{1}; }, [&]
+                   { return std::size_t{q.dequeue().has_value()}; });
+    }
+
+    std::printf("--- ping-pong (round trips/s, round trip latency)\n");
+    {
+        ring_buffer::spsc_ring<std::size_t> ping{64}, pong{64};
+        ping_pong("spsc_ring", ping, pong, [](auto &q, std::size_t v)
+                  { while (!q.try_enqueue(v)) ; }, [](auto &q)
+                  { return q.try_dequeue(); });
+    }
+    {
+        ms_queue::lf_queue<std::size_t> ping, pong;
+        ping_pong("lf_queue", ping, pong, [](auto &q, std::size_t v)
+                  { q.enqueue(v); }, [](auto &q)
+                  { return q.dequeue(); });
+    }
+}
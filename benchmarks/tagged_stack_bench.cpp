@@ -0,0 +1,42 @@
+// Tagged-pointer Treiber stack vs the two atomic shared_ptr ones, as threads grow
+//   tagged_stack         versioned 64 bit head, nodes recycled through a free list
+//   Stack (cpp20)        std::atomic<std::shared_ptr>
+//   lf_stack (pre cpp20) std::atomic_load / atomic_compare_exchange_weak on a std::shared_ptr
+// Each thread alternates push and pop, the worst case for a single head
+
+// g++ -std=c++20 -O2 -pthread tagged_stack_bench.cpp -latomic
+// Usage : ./bench [max_threads]
+
+#include <cstdio>
+#include "bench_util.h"
+#include "../concurrent_data_structures/treiber_stack/stl_lock_free_stack_cpp20.h"
+#include "../concurrent_data_structures/treiber_stack/stl_stack_before_cpp20.h"
+#include "../concurrent_data_structures/treiber_stack/tagged_pointer_stack.h"
+
+constexpr std::size_t ops_per_thread = 200'000;
+
+template <typename S>
+void run(const char *name, unsigned threads)
+{
+    S stack;
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        for (std::size_t k = 0; k < ops_per_thread / 2; ++k)
+        {
+            stack.push(static_cast<int>(i + k));
+            stack.pop();
+        } });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+}
+
+int main(int argc, char **argv)
+{
+    std::printf("std::atomic<shared_ptr> always lock-free : %d\n", std::atomic<std::shared_ptr<int>>::is_always_lock_free);
+    std::printf("std::atomic<uint64_t> (tagged head) always lock-free : %d\n", std::atomic<std::uint64_t>::is_always_lock_free);
+    for (auto n : bench::thread_counts(bench::max_threads(argc, argv)))
+    {
+        run<lock_free::tagged_stack<int>>("tagged_stack", n);
+        run<lock_free::Stack<int>>("Stack (cpp20)", n);
+        run<lock_free::lf_stack<int>>("lf_stack (pre cpp20)", n);
+    }
+}
@@ -0,0 +1,46 @@
+// ms_queue::wf_queue against ms_queue::lf_queue : tail latency when oversubscribed
+// Every thread runs enqueue / dequeue pairs and times each op. With more threads than cores,
+// threads get preempted in the middle of an op, and lf_queue ops on the others can keep failing
+// their CAS against the preempted one's progress ; wf_queue bounds the retries, then gets helped.
+// lf_queue runs with epochs (same reclamation as wf_queue) and with std::atomic<std::shared_ptr>.
+
+// g++ -std=c++20 -O2 -pthread wait_free_queue_bench.cpp -latomic
+// Usage : ./bench [max_threads]   (defaults to 4x the hardware threads)
+
+#include "bench_util.h"
+#include "../atomic_shared_pointers/epoch_based_reclamation.h"
+#include "../concurrent_data_structures/ms_queue/lock_free_with_asp.h"
+#include "../concurrent_data_structures/ms_queue/wait_free_queue.h"
+
+constexpr std::size_t ops_per_thread = 200'000;
+
+template <typename Q>
+void pairs(const char *name, unsigned threads)
+{
+    Q q;
+    for (std::uint64_t i = 0; i < 1024; ++i) // keep dequeues mostly non empty
+        q.enqueue(i);
+    bench::latencies lat{threads, ops_per_thread};
+    auto secs = bench::run_threads(threads, [&](unsigned i)
+                                   {
+        for (std::size_t n = 0; n < ops_per_thread / 2; ++n)
+        {
+            lat.time(i, [&] { q.enqueue(n); });
+            lat.time(i, [&] { q.dequeue(); });
+        } });
+    bench::report(name, threads, threads * ops_per_thread, secs);
+    lat.report();
+}
+
+int main(int argc, char **argv)
+{
+    auto hw = std::max(1u, std::thread::hardware_concurrency());
+    auto max = argc > 1 ? bench::max_threads(argc, argv) : 4 * hw;
+    std::printf("hardware threads %u\n", hw);
+    for (auto n : bench::thread_counts(max))
+    {
+        pairs<ms_queue::wf_queue<std::uint64_t>>("wf_queue", n);
+        pairs<ms_queue::lf_queue<std::uint64_t, std::allocator<std::uint64_t>, ebr::ebr_policy>>("lf_queue (epochs)", n);
+        pairs<ms_queue::lf_queue<std::uint64_t>>("lf_queue (std asp)", n);
+    }
+}
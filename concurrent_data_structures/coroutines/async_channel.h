@@ -0,0 +1,166 @@
+// Unbounded MPMC channel for C++20 coroutines, on top of ms_queue::lf_queue :
+//     T v = co_await ch.receive();      co_await ch.send(v);   (or ch.send_now(v) outside coroutines)
+// A receiver finding the channel empty suspends instead of polling, and the producer of the next
+// item hands it over and resumes it directly : no thread blocks, and no poll interval in between.
+
+// `balance` counts items minus receivers waiting for one :
+//   receive : balance-- . If it was > 0 an item is (already) in `items` and ours, dequeue it, no
+//             suspension. Otherwise enqueue ourselves (the awaiter, inside the coroutine frame)
+//             into `waiters`, then drain().
+//   send    : enqueue the item, then balance++ . If it was < 0 a receiver is owed an item :
+//             pending++, then drain().
+// drain() pairs waiters with pending handoffs : while both are there, take a waiter, claim a
+// pending, dequeue an item for the waiter and resume it. The producer doesn't wait for the
+// receiver it owes to show up in `waiters` (it may not have enqueued itself yet) : each side
+// publishes its half and then drains, with a fence in between, so whichever comes second sees
+// both. A receiver may find and serve itself, then it doesn't suspend at all.
+// Every increment comes after its item is enqueued, and every dequeue pairs with one increment
+// that happened before it, so those dequeues never find the queue empty. Both queues are
+// lock-free and the fast paths (item there, or nobody waiting) are one RMW on top of the queue op.
+
+// Resume : where waiters get resumed, called as resume(std::coroutine_handle<>) on the producer's
+// thread. The default (inline_resume) runs the receiver right there, inside send, until its next
+// suspension. Pass one that posts the handle to your executor to keep receivers on their own
+// threads (see benchmarks/async_channel_bench.cpp).
+
+// The channel must outlive every suspended receiver.
+
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include "../../atomic_shared_pointers/epoch_based_reclamation.h"
+#include "../ms_queue/lock_free_with_asp.h"
+
+namespace coro
+{
+    struct inline_resume
+    {
+        void operator()(std::coroutine_handle<> h) const { h.resume(); }
+    };
+
+    template <typename T, typename Resume = inline_resume>
+    class async_channel
+    {
+        class receive_awaiter;
+        template <typename U>
+        using queue = ms_queue::lf_queue<U, std::allocator<U>, ebr::ebr_policy>;
+
+        queue<T> items;
+        queue<receive_awaiter *> waiters;
+        alignas(64) std::atomic<std::int64_t> balance{0};
+        alignas(64) std::atomic<std::int64_t> pending{0}; // items owed to receivers, not handed over yet
+        std::atomic<std::uint64_t> tickets{0};            // numbers suspending receives, see drain()
+        [[no_unique_address]] Resume resume;
+
+        class receive_awaiter
+        {
+            friend class async_channel;
+            async_channel &ch;
+            std::optional<T> value;
+            std::coroutine_handle<> handle;
+            std::uint64_t ticket{};
+
+        public:
+            explicit receive_awaiter(async_channel &c) : ch{c} {}
+
+            bool await_ready()
+            {
+                if (ch.balance.fetch_sub(1) > 0)
+                {
+                    value = ch.items.dequeue(); // backed by a counted item, never empty
+                    return true;
+                }
+                return false;
+            }
+            bool await_suspend(std::coroutine_handle<> h)
+            {
+                handle = h;
+                auto &c = ch;
+                auto t = ticket = c.tickets.fetch_add(1, std::memory_order_relaxed) + 1;
+                // from here on a producer may resume us (and destroy this awaiter) at any time
+                c.waiters.enqueue(this);
+                return !c.drain(t); // false : we served ourselves, go on without suspending
+            }
+            T await_resume() { return std::move(*value); }
+        };
+
+        // Hands pending items to waiting receivers while there are both. Returns whether it served
+        // the receive with ticket self (0 : none), which is left to the caller to resume. Any other
+        // receiver is resumed through the hook. Not by address : once enqueued, our awaiter may be
+        // resumed elsewhere and its frame reused by another receive, tickets never repeat.
+        bool drain(std::uint64_t self)
+        {
+            bool served_self = false;
+            std::atomic_thread_fence(std::memory_order_seq_cst); // our enqueue / pending++ before their check
+            while (pending.load() > 0)
+            {
+                auto w = waiters.dequeue();
+                if (!w)
+                    break; // the receiver drains once it enqueues itself
+                auto p = pending.load();
+                while (p > 0 && !pending.compare_exchange_weak(p, p - 1))
+                    ;
+                if (p == 0) // another drain took the handoff meanwhile
+                {
+                    waiters.enqueue(*w);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    continue;
+                }
+                (*w)->value = items.dequeue(); // backed by a counted item, never empty
+                if ((*w)->ticket == self) // ours to read until resumed
+                    served_self = true;
+                else
+                    resume((*w)->handle);
+            }
+            return served_self;
+        }
+
+        class send_awaiter
+        {
+            async_channel &ch;
+            T value;
+
+        public:
+            send_awaiter(async_channel &c, T v) : ch{c}, value{std::move(v)} {}
+            bool await_ready() const noexcept { return true; } // unbounded : never suspends
+            void await_suspend(std::coroutine_handle<>) const noexcept {}
+            void await_resume() { ch.send_now(std::move(value)); }
+        };
+
+    public:
+        explicit async_channel(Resume r = {}) : resume{std::move(r)} {}
+        async_channel(const async_channel &) = delete;
+        async_channel &operator=(const async_channel &) = delete;
+
+        // co_await ch.receive() : the next item, suspends while the channel is empty
+        [[nodiscard]] receive_awaiter receive() { return receive_awaiter{*this}; }
+
+        // co_await ch.send(v)
+        [[nodiscard]] send_awaiter send(T v) { return send_awaiter{*this, std::move(v)}; }
+
+        // Sends from anywhere, coroutine or not. Resumes a waiting receiver through the hook.
+        void send_now(T v)
+        {
+            items.enqueue(std::move(v));
+            if (balance.fetch_add(1) >= 0)
+                return;
+            pending.fetch_add(1);
+            drain(0);
+        }
+
+        // Non suspending receive : an item if one is there without waiting
+        std::optional<T> try_receive()
+        {
+            auto b = balance.load();
+            while (b > 0)
+                if (balance.compare_exchange_weak(b, b - 1))
+                    return items.dequeue();
+            return {};
+        }
+    };
+}
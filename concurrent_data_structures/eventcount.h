@@ -0,0 +1,160 @@
+// Eventcount : lets consumers of a non-blocking structure block until something shows up,
+// without putting a lock or a syscall on the producer's path (Vyukov's eventcount).
+
+// Consumer (wait) : spin on try_take() for a while. When that fails, announce itself in `waiters`,
+// remember `epoch`, try once more, then park until `epoch` moves (futex on Linux, atomic::wait
+// elsewhere), and start over.
+// Producer (notify_one / notify_all, after publishing) : a fence and a relaxed load of `waiters`.
+// Only when someone is parked (or about to) does it bump `epoch` and make the wake syscall.
+// The fences on both sides order "publish, then read waiters" against "announce, then try again"
+// (store -> load, which acquire / release doesn't order) : either the consumer's last try sees
+// the item, or the producer sees the waiter and moves epoch, and then the park returns at once.
+
+// Spinning is adaptive : the spin budget grows when spinning pays off (an item showed up before
+// the budget ran out) and shrinks every time the consumer had to park anyway.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#ifdef __linux__
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace lock_free
+{
+    class eventcount
+    {
+        static constexpr std::uint32_t min_spins = 4;
+        static constexpr std::uint32_t max_spins = 1024;
+        static constexpr std::uint32_t pause_spins = 16; // then yield for the rest of the budget
+
+        alignas(64) std::atomic<std::uint32_t> epoch{0};
+        std::atomic<std::uint32_t> waiters{0};
+        std::atomic<std::uint32_t> spin_budget{64}; // racy hint, relaxed on purpose
+
+        static void cpu_relax()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+
+        // Sleeps while epoch == key, or until the timeout (ns, negative for none)
+        void park(std::uint32_t key, long long timeout_ns)
+        {
+#ifdef __linux__
+            static_assert(sizeof(epoch) == sizeof(std::uint32_t) && std::atomic<std::uint32_t>::is_always_lock_free);
+            timespec ts{}, *tsp = nullptr;
+            if (timeout_ns >= 0)
+            {
+                ts.tv_sec = static_cast<time_t>(timeout_ns / 1'000'000'000);
+                ts.tv_nsec = static_cast<long>(timeout_ns % 1'000'000'000);
+                tsp = &ts;
+            }
+            // returns at once if epoch != key already, spurious wakeups are fine (caller loops)
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&epoch), FUTEX_WAIT_PRIVATE, key, tsp, nullptr, 0);
+#else
+            if (timeout_ns < 0)
+                epoch.wait(key, std::memory_order_acquire);
+            else // no timed atomic::wait : nap in short slices
+                std::this_thread::sleep_for(std::chrono::nanoseconds{std::min(timeout_ns, 1'000'000ll)});
+#endif
+        }
+
+        void wake(int n)
+        {
+            epoch.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+            syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&epoch), FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
+#else
+            if (n == 1)
+                epoch.notify_one();
+            else
+                epoch.notify_all();
+#endif
+        }
+
+        void notify(int n)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiters.load(std::memory_order_relaxed))
+                wake(n);
+        }
+
+        // try_take returns something testable like std::optional, empty meaning nothing to take.
+        // Gives up once deadline (steady clock) has passed, if there is one.
+        template <typename F>
+        std::invoke_result_t<F &> wait(F &try_take, std::optional<std::chrono::steady_clock::time_point> deadline)
+        {
+            auto budget = spin_budget.load(std::memory_order_relaxed);
+            for (std::uint32_t i = 0; i < budget; ++i)
+            {
+                if (auto r = try_take())
+                {
+                    if (i >= budget / 2) // nearly ran out : spin a little longer next time
+                        spin_budget.store(std::min(max_spins, budget + budget / 4 + 1), std::memory_order_relaxed);
+                    return r;
+                }
+                if (i < pause_spins)
+                    cpu_relax();
+                else
+                    std::this_thread::yield();
+            }
+            spin_budget.store(std::max(min_spins, budget - budget / 4), std::memory_order_relaxed);
+            while (true)
+            {
+                auto key = epoch.load(std::memory_order_acquire);
+                waiters.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto r = try_take();
+                long long timeout_ns = -1;
+                if (!r && deadline)
+                    timeout_ns = std::max<long long>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(*deadline - std::chrono::steady_clock::now()).count());
+                if (r || timeout_ns == 0)
+                {
+                    waiters.fetch_sub(1, std::memory_order_relaxed);
+                    return r;
+                }
+                park(key, timeout_ns);
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+    public:
+        eventcount() = default;
+        eventcount(const eventcount &) = delete;
+        eventcount &operator=(const eventcount &) = delete;
+
+        // Producers, after the item is published
+        void notify_one() { notify(1); }
+        void notify_all() { notify(INT_MAX); }
+
+        // Blocks until try_take() returns a non empty result, and returns it
+        template <typename F>
+        std::invoke_result_t<F &> await(F try_take) { return wait(try_take, std::nullopt); }
+
+        // Same, but returns the empty result once timeout has passed
+        template <typename F, typename Rep, typename Period>
+        std::invoke_result_t<F &> await_for(F try_take, const std::chrono::duration<Rep, Period> &timeout)
+        {
+            return wait(try_take, std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout));
+        }
+
+        template <typename F, typename Clock, typename Duration>
+        std::invoke_result_t<F &> await_until(F try_take, const std::chrono::time_point<Clock, Duration> &deadline)
+        {
+            // other clocks are mapped onto the steady clock once, at the start
+            return wait(try_take, std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(deadline - Clock::now()));
+        }
+    };
+}
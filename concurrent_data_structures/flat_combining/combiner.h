@@ -0,0 +1,125 @@
+// Flat combining (Hendler, Incze, Shavit, Tzafrir, "Flat combining and the synchronization-
+// parallelism tradeoff", SPAA 2010)
+
+// Under contention a CAS loop on one hot word (the stack's head, the queue's tail) spends most of
+// its time moving that cache line between cores, and most of the CASes fail anyway. Flat combining
+// gives up on concurrency inside the structure instead : a plain sequential structure sits behind
+// one lock, and threads don't fight for the lock either.
+//   - each thread writes its request into its own publication record and raises `pending`
+//   - whoever gets the lock becomes the combiner : it walks all records and applies every pending
+//     request in turn, writing the results back and dropping `pending`. The structure stays hot
+//     in its cache for the whole batch.
+//   - everyone else spins on its own record (a line nobody else writes until the answer), and
+//     only tries the lock again if it is free and their request is still pending.
+// One lock handoff serves a whole batch, so throughput grows with contention where CAS loops
+// collapse. At low thread counts it costs a record round trip more than a plain lock.
+
+// Records live in a fixed array indexed by thread_index() (thread_index.h), and the combiner only
+// scans up to its high water mark. Operations from more than MaxThreads threads alive at once
+// throw std::length_error.
+
+// An exception thrown by apply() (eg bad_alloc growing the structure) belongs to the thread whose
+// request it was : the combiner stores it in that record, carries on with the batch, and the owner
+// rethrows it from execute(). The lock is released whatever happens.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include "../thread_index.h"
+
+namespace flat_combining
+{
+    // Op : request + room for its result, filled in by apply(Op &) under the combiner lock
+    template <typename Op, std::size_t MaxThreads = 128>
+    class combiner
+    {
+        static constexpr int max_passes = 3;    // more passes while they keep finding requests
+        static constexpr unsigned spins_before_yield = 64;
+
+        struct alignas(64) record
+        {
+            std::atomic<bool> pending{false};
+            Op op{};
+            std::exception_ptr error; // apply() threw for this request
+        };
+
+        alignas(64) std::atomic<bool> locked{false};
+        record records[MaxThreads];
+
+        bool try_lock()
+        {
+            return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+        }
+
+        template <typename Apply>
+        void combine(Apply &apply)
+        {
+            struct unlock_on_exit
+            {
+                std::atomic<bool> &locked;
+                ~unlock_on_exit() { locked.store(false, std::memory_order_release); }
+            } unlock{locked};
+            auto n = std::min(lock_free::thread_index_high_water(), MaxThreads);
+            for (int pass = 0; pass < max_passes; ++pass)
+            {
+                bool found = false;
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    auto &r = records[i];
+                    if (!r.pending.load(std::memory_order_acquire))
+                        continue;
+                    try
+                    {
+                        apply(r.op);
+                    }
+                    catch (...)
+                    {
+                        r.error = std::current_exception();
+                    }
+                    r.pending.store(false, std::memory_order_release);
+                    found = true;
+                }
+                if (!found)
+                    break;
+            }
+        }
+
+    public:
+        combiner() = default;
+        combiner(const combiner &) = delete;
+        combiner &operator=(const combiner &) = delete;
+
+        // Publishes op and returns it once applied, by us as the combiner or by another thread
+        // Rethrows what apply() threw for op
+        template <typename Apply>
+        Op execute(Op op, Apply &&apply)
+        {
+            auto i = lock_free::thread_index();
+            if (i >= MaxThreads)
+                throw std::length_error{"flat_combining::combiner : more threads than MaxThreads"};
+            auto &r = records[i];
+            r.op = std::move(op);
+            r.pending.store(true, std::memory_order_release);
+            unsigned spins = 0;
+            while (true)
+            {
+                if (try_lock())
+                    combine(apply); // our record is pending, so this pass applies it
+                if (!r.pending.load(std::memory_order_acquire))
+                {
+                    if (r.error)
+                        std::rethrow_exception(std::exchange(r.error, nullptr));
+                    return std::move(r.op);
+                }
+                if (++spins >= spins_before_yield)
+                    std::this_thread::yield(); // the combiner may be preempted, give it the core
+            }
+        }
+    };
+}
@@ -0,0 +1,57 @@
+// Flat combining queue : a std::deque behind a combiner (combiner.h).
+// Same interface as ms_queue::lf_queue (enqueue / dequeue), for the contention levels where the
+// MS queue's CASes on tail and head turn into cache line ping-pong. Enqueues and dequeues share
+// one combiner, so a batch mixes both, applied in record order.
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <utility>
+#include "combiner.h"
+
+namespace flat_combining
+{
+    template <typename T, std::size_t MaxThreads = 128>
+    class fc_queue
+    {
+        struct op
+        {
+            bool enqueue;
+            std::optional<T> value; // enqueue : the element, dequeue : the result
+        };
+
+        std::deque<T> items; // touched by the combiner only
+        combiner<op, MaxThreads> c;
+
+        void apply(op &o)
+        {
+            if (o.enqueue)
+            {
+                items.push_back(std::move(*o.value));
+                o.value.reset();
+            }
+            else if (!items.empty())
+            {
+                o.value.emplace(std::move(items.front()));
+                items.pop_front();
+            }
+        }
+
+    public:
+        fc_queue() = default;
+        fc_queue(const fc_queue &) = delete;
+        fc_queue &operator=(const fc_queue &) = delete;
+
+        void enqueue(T t)
+        {
+            c.execute(op{true, std::move(t)}, [this](op &o) { apply(o); });
+        }
+
+        std::optional<T> dequeue()
+        {
+            return c.execute(op{false, std::nullopt}, [this](op &o) { apply(o); }).value;
+        }
+    };
+}
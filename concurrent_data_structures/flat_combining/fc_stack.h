@@ -0,0 +1,57 @@
+// Flat combining stack : a std::vector behind a combiner (combiner.h).
+// Same interface as lock_free::Stack (push / pop), for the contention levels where the Treiber
+// stack's CAS on head turns into cache line ping-pong. No node per element either : once the
+// vector has grown, push and pop don't allocate.
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "combiner.h"
+
+namespace flat_combining
+{
+    template <typename T, std::size_t MaxThreads = 128>
+    class fc_stack
+    {
+        struct op
+        {
+            bool push;
+            std::optional<T> value; // push : the element, pop : the result
+        };
+
+        std::vector<T> items; // touched by the combiner only
+        combiner<op, MaxThreads> c;
+
+        void apply(op &o)
+        {
+            if (o.push)
+            {
+                items.push_back(std::move(*o.value));
+                o.value.reset();
+            }
+            else if (!items.empty())
+            {
+                o.value.emplace(std::move(items.back()));
+                items.pop_back();
+            }
+        }
+
+    public:
+        fc_stack() = default;
+        fc_stack(const fc_stack &) = delete;
+        fc_stack &operator=(const fc_stack &) = delete;
+
+        void push(T t)
+        {
+            c.execute(op{true, std::move(t)}, [this](op &o) { apply(o); });
+        }
+
+        std::optional<T> pop()
+        {
+            return c.execute(op{false, std::nullopt}, [this](op &o) { apply(o); }).value;
+        }
+    };
+}
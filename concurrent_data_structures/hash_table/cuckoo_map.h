@@ -0,0 +1,414 @@
+// Concurrent hash map using optimistic cuckoo hashing (MemC3, Fan et al. NSDI 2013, and its
+// multi-writer version from Li et al. EuroSys 2014, ie libcuckoo), see lock_free_data_structures.md
+
+// 4-way set associative : every key can live in one of 4 slots of either of its 2 buckets.
+// A slot is a one byte tag (from the key's hash) and a pointer to the (key, value) entry, so a
+// bucket is 4 tags + 4 pointers in one cache line and a lookup only dereferences entries whose
+// tag matches. The alternate bucket is computed from the bucket and the tag alone (partial-key
+// cuckoo hashing), so an entry can be displaced without rehashing its key.
+
+// Concurrency : an array of striped version counters (bucket b maps to stripe b % stripe_count),
+// each a seqlock : odd while a writer holds it.
+//   readers : read both stripes' versions, scan both buckets, re-read the versions, retry if they
+//             changed, ie a displacement may have moved the key under us. No writes to shared memory.
+//   writers : lock the two stripes of the key's buckets (lower stripe first), so writers on
+//             different stripes run in parallel.
+// When both buckets are full, insert searches a cuckoo path breadth-first, without locks, to a
+// bucket with a free slot, then moves the hole backwards one displacement at a time, locking only
+// the 2 buckets involved in each. Nothing is ever "floating" outside the table, so readers never
+// miss a key which is present. If a step finds its source or target changed, insert starts over.
+// If there is no path within max_path_len displacements the table doubles, all stripes locked.
+
+// Entries and replaced bucket arrays are reclaimed with epoch-based reclamation
+// (epoch_based_reclamation.h) : readers may still be looking at them after an erase / resize.
+// Entries are immutable, insert() doesn't overwrite an existing key.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../../atomic_shared_pointers/epoch_based_reclamation.h"
+
+namespace hash_table
+{
+    template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+    class cuckoo_map
+    {
+        static constexpr std::size_t slots_per_bucket = 4;
+        static constexpr std::size_t stripe_count = 2048;
+        static constexpr std::size_t max_path_len = 5;
+
+        struct entry
+        {
+            std::pair<const K, V> kv;
+            std::size_t hash;
+        };
+
+        struct alignas(64) bucket
+        {
+            std::atomic<std::uint8_t> tags[slots_per_bucket]{};
+            std::atomic<entry *> slots[slots_per_bucket]{};
+        };
+        static_assert(sizeof(bucket) == 64, "a bucket is one cache line");
+
+        struct table
+        {
+            std::size_t mask;
+            bucket *buckets;
+            explicit table(std::size_t n) : mask{n - 1}, buckets{new bucket[n]} {}
+            ~table() { delete[] buckets; } // entries belong to whichever table holds them now
+            table(const table &) = delete;
+            table &operator=(const table &) = delete;
+        };
+
+        std::atomic<table *> tbl;
+        alignas(64) std::atomic<std::uint64_t> versions[stripe_count]{};
+        alignas(64) std::atomic<std::size_t> count{0};
+        [[no_unique_address]] Hash hasher{};
+        [[no_unique_address]] KeyEqual key_eq{};
+
+        // std::hash of an integer is the identity, mix so that both tag and index bits are random
+        std::size_t hash_of(const K &key) const
+        {
+            std::uint64_t h = hasher(key);
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return static_cast<std::size_t>(h);
+        }
+        static std::uint8_t tag_of(std::size_t h)
+        {
+            auto t = static_cast<std::uint8_t>(h >> 56);
+            return t ? t : 1; // 0 marks an empty slot
+        }
+        // partial-key cuckoo : alt(alt(b, tag), tag) == b
+        static std::size_t alt_bucket(std::size_t b, std::uint8_t tag, std::size_t mask)
+        {
+            return (b ^ ((tag + 1) * 0xc6a4a7935bd1e995ull)) & mask;
+        }
+        static std::size_t stripe_of(std::size_t b) { return b & (stripe_count - 1); }
+
+        void lock(std::size_t s)
+        {
+            auto &v = versions[s];
+            auto x = v.load(std::memory_order_relaxed);
+            while (true)
+            {
+                if (x & 1)
+                {
+                    std::this_thread::yield();
+                    x = v.load(std::memory_order_relaxed);
+                }
+                else if (v.compare_exchange_weak(x, x + 1, std::memory_order_acquire, std::memory_order_relaxed))
+                    break;
+            }
+            // seqlock writer : the odd version must be visible before any of our slot writes
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+        void unlock(std::size_t s)
+        {
+            versions[s].fetch_add(1, std::memory_order_release);
+        }
+        void lock_pair(std::size_t b1, std::size_t b2)
+        {
+            auto s1 = stripe_of(b1), s2 = stripe_of(b2);
+            if (s1 > s2)
+                std::swap(s1, s2);
+            lock(s1);
+            if (s2 != s1)
+                lock(s2);
+        }
+        void unlock_pair(std::size_t b1, std::size_t b2)
+        {
+            auto s1 = stripe_of(b1), s2 = stripe_of(b2);
+            unlock(s1);
+            if (s2 != s1)
+                unlock(s2);
+        }
+
+        entry *lookup(bucket &b, std::uint8_t tag, const K &key, std::size_t &slot) const
+        {
+            for (std::size_t i = 0; i < slots_per_bucket; ++i)
+            {
+                if (b.tags[i].load(std::memory_order_relaxed) != tag)
+                    continue;
+                auto e = b.slots[i].load(std::memory_order_acquire);
+                if (e && key_eq(e->kv.first, key))
+                {
+                    slot = i;
+                    return e;
+                }
+            }
+            return nullptr;
+        }
+
+        static void put(bucket &b, std::size_t i, std::uint8_t tag, entry *e)
+        {
+            b.tags[i].store(tag, std::memory_order_relaxed);
+            b.slots[i].store(e, std::memory_order_release);
+        }
+        static void clear(bucket &b, std::size_t i)
+        {
+            b.slots[i].store(nullptr, std::memory_order_relaxed);
+            b.tags[i].store(0, std::memory_order_relaxed);
+        }
+        static bool try_put(bucket &b, std::uint8_t tag, entry *e)
+        {
+            for (std::size_t i = 0; i < slots_per_bucket; ++i)
+                if (!b.slots[i].load(std::memory_order_relaxed))
+                {
+                    put(b, i, tag, e);
+                    return true;
+                }
+            return false;
+        }
+
+        // Cuckoo path search (breadth-first, no locks) from b1 / b2 to a bucket with a free slot,
+        // then moves the hole back to b1 / b2 one locked displacement at a time
+        // Returns false if no path exists within max_path_len (time to grow)
+        bool make_room(table *t, std::size_t b1, std::size_t b2)
+        {
+            struct step
+            {
+                std::size_t bucket;
+                int parent;         // index into path, -1 for b1 / b2
+                std::uint8_t slot;  // slot of parent's bucket whose entry moves here
+                std::uint8_t depth;
+            };
+            std::vector<step> path{{b1, -1, 0, 0}, {b2, -1, 0, 0}};
+            int hole_at = -1;
+            std::size_t hole_slot = 0;
+            for (std::size_t i = 0; i < path.size() && hole_at < 0; ++i)
+            {
+                auto &b = t->buckets[path[i].bucket];
+                for (std::size_t s = 0; s < slots_per_bucket; ++s)
+                    if (!b.slots[s].load(std::memory_order_relaxed))
+                    {
+                        hole_at = static_cast<int>(i);
+                        hole_slot = s;
+                        break;
+                    }
+                if (hole_at < 0 && path[i].depth < max_path_len)
+                    for (std::size_t s = 0; s < slots_per_bucket; ++s)
+                        path.push_back({alt_bucket(path[i].bucket, b.tags[s].load(std::memory_order_relaxed), t->mask),
+                                        static_cast<int>(i), static_cast<std::uint8_t>(s),
+                                        static_cast<std::uint8_t>(path[i].depth + 1)});
+            }
+            if (hole_at < 0)
+                return false;
+
+            // hole_at's entry comes from its parent's slot, which becomes the hole, and so on up
+            for (auto i = hole_at; path[i].parent >= 0; i = path[i].parent)
+            {
+                auto from = path[path[i].parent].bucket, to = path[i].bucket;
+                auto &src = t->buckets[from];
+                auto &dst = t->buckets[to];
+                auto s = path[i].slot;
+                lock_pair(from, to);
+                bool ok = tbl.load(std::memory_order_relaxed) == t && !dst.slots[hole_slot].load(std::memory_order_relaxed);
+                auto e = src.slots[s].load(std::memory_order_relaxed);
+                auto tag = src.tags[s].load(std::memory_order_relaxed);
+                ok = ok && e && alt_bucket(from, tag, t->mask) == to; // someone else's entry is fine, if it goes there too
+                if (ok)
+                {
+                    put(dst, hole_slot, tag, e); // copy first then clear : the entry is never missing
+                    clear(src, s);
+                }
+                unlock_pair(from, to);
+                if (!ok)
+                    return true; // things moved under us, let insert look again
+                hole_slot = s;
+            }
+            return true;
+        }
+
+        // Doubles the table (more if entries still don't fit) with every stripe locked
+        void grow(table *t)
+        {
+            for (std::size_t s = 0; s < stripe_count; ++s)
+                lock(s);
+            if (tbl.load(std::memory_order_relaxed) == t)
+            {
+                auto n = 2 * (t->mask + 1);
+                table *bigger;
+                while (!(bigger = rehash(t, n)))
+                    n *= 2;
+                tbl.store(bigger, std::memory_order_release);
+                ebr::default_domain().retire(t);
+            }
+            for (std::size_t s = 0; s < stripe_count; ++s)
+                unlock(s);
+        }
+
+        // Into a private table : plain random walk cuckoo insertion, no locks needed
+        // Returns false if e (or an entry it kicked out) found no place, the table is then dropped
+        static bool place(table *t, entry *e)
+        {
+            auto tag = tag_of(e->hash);
+            auto b = e->hash & t->mask;
+            if (try_put(t->buckets[b], tag, e))
+                return true;
+            b = alt_bucket(b, tag, t->mask);
+            for (std::size_t kick = 0; kick < 500; ++kick)
+            {
+                auto &bk = t->buckets[b];
+                if (try_put(bk, tag, e))
+                    return true;
+                auto i = (b + kick) % slots_per_bucket;
+                auto victim = bk.slots[i].load(std::memory_order_relaxed);
+                auto victim_tag = bk.tags[i].load(std::memory_order_relaxed);
+                put(bk, i, tag, e);
+                e = victim;
+                tag = victim_tag;
+                b = alt_bucket(b, tag, t->mask);
+            }
+            return false;
+        }
+
+        // Entries stay in t as well, so giving up loses nothing
+        static table *rehash(table *t, std::size_t n)
+        {
+            auto bigger = new table{n};
+            for (std::size_t b = 0; b <= t->mask; ++b)
+                for (auto &s : t->buckets[b].slots)
+                    if (auto e = s.load(std::memory_order_relaxed); e && !place(bigger, e))
+                    {
+                        delete bigger;
+                        return nullptr;
+                    }
+            return bigger;
+        }
+
+    public:
+        explicit cuckoo_map(std::size_t capacity = 1024)
+        {
+            std::size_t n = 2;
+            while (n * slots_per_bucket < capacity)
+                n *= 2;
+            tbl.store(new table{n}, std::memory_order_relaxed);
+        }
+        cuckoo_map(const cuckoo_map &) = delete;
+        cuckoo_map &operator=(const cuckoo_map &) = delete;
+        ~cuckoo_map()
+        {
+            auto t = tbl.load(std::memory_order_relaxed);
+            for (std::size_t b = 0; b <= t->mask; ++b)
+                for (auto &s : t->buckets[b].slots)
+                    delete s.load(std::memory_order_relaxed);
+            delete t;
+        }
+
+        bool insert(K key, V value)
+        {
+            auto h = hash_of(key);
+            auto tag = tag_of(h);
+            auto e = new entry{{std::move(key), std::move(value)}, h};
+            ebr::guard g;
+            while (true)
+            {
+                auto t = tbl.load(std::memory_order_acquire);
+                auto b1 = h & t->mask, b2 = alt_bucket(b1, tag, t->mask);
+                lock_pair(b1, b2);
+                if (tbl.load(std::memory_order_relaxed) != t) // grown while we waited
+                {
+                    unlock_pair(b1, b2);
+                    continue;
+                }
+                std::size_t slot;
+                if (lookup(t->buckets[b1], tag, e->kv.first, slot) || lookup(t->buckets[b2], tag, e->kv.first, slot))
+                {
+                    unlock_pair(b1, b2);
+                    delete e;
+                    return false;
+                }
+                bool placed = try_put(t->buckets[b1], tag, e) || try_put(t->buckets[b2], tag, e);
+                unlock_pair(b1, b2);
+                if (placed)
+                {
+                    count.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                if (!make_room(t, b1, b2))
+                    grow(t);
+            }
+        }
+
+        bool erase(const K &key)
+        {
+            auto h = hash_of(key);
+            auto tag = tag_of(h);
+            ebr::guard g;
+            while (true)
+            {
+                auto t = tbl.load(std::memory_order_acquire);
+                auto b1 = h & t->mask, b2 = alt_bucket(b1, tag, t->mask);
+                lock_pair(b1, b2);
+                if (tbl.load(std::memory_order_relaxed) != t)
+                {
+                    unlock_pair(b1, b2);
+                    continue;
+                }
+                std::size_t slot;
+                auto b = b1;
+                auto e = lookup(t->buckets[b1], tag, key, slot);
+                if (!e)
+                    e = lookup(t->buckets[b = b2], tag, key, slot);
+                if (e)
+                    clear(t->buckets[b], slot);
+                unlock_pair(b1, b2);
+                if (!e)
+                    return false;
+                count.fetch_sub(1, std::memory_order_relaxed);
+                ebr::default_domain().retire(e);
+                return true;
+            }
+        }
+
+        // Optimistic : a hit is returned right away (the entry was in the table when we read its
+        // pointer), a miss only once both stripes' versions show no writer got in between
+        std::optional<V> find(const K &key)
+        {
+            auto h = hash_of(key);
+            auto tag = tag_of(h);
+            ebr::guard g;
+            while (true)
+            {
+                auto t = tbl.load(std::memory_order_acquire);
+                auto b1 = h & t->mask, b2 = alt_bucket(b1, tag, t->mask);
+                auto &v1 = versions[stripe_of(b1)], &v2 = versions[stripe_of(b2)];
+                auto x1 = v1.load(std::memory_order_acquire), x2 = v2.load(std::memory_order_acquire);
+                if ((x1 | x2) & 1) // writer in there
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (tbl.load(std::memory_order_acquire) != t)
+                    continue;
+                std::size_t slot;
+                if (auto e = lookup(t->buckets[b1], tag, key, slot))
+                    return e->kv.second;
+                if (auto e = lookup(t->buckets[b2], tag, key, slot))
+                    return e->kv.second;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (v1.load(std::memory_order_relaxed) == x1 && v2.load(std::memory_order_relaxed) == x2)
+                    return {};
+            }
+        }
+
+        bool contains(const K &key)
+        {
+            return find(key).has_value();
+        }
+
+        std::size_t size() const { return count.load(std::memory_order_relaxed); }
+        std::size_t bucket_count() const { return tbl.load(std::memory_order_relaxed)->mask + 1; }
+    };
+}
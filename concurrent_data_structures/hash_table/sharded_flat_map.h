@@ -0,0 +1,348 @@
+// Sharded open addressing hash map, after parallel-hashmap (see lock_free_data_structures.md) :
+// 2^ShardBits submaps, each a Swiss table (Abseil's flat_hash_map design) behind its own mutex.
+
+// The top ShardBits bits of the hash pick the submap, so threads working on different submaps
+// never touch the same lock or cache lines, and a submap grows alone : while it rehashes, only
+// its own old and new arrays are alive together (1 / 2^ShardBits of the whole table) instead of
+// the whole table twice, and the other submaps stay available.
+
+// Inside a submap : one control byte per slot, either empty, deleted, or the low 7 bits of the
+// key's hash (h2) when full. Slots are split into groups of group::width, and a probe loads a
+// group's control bytes at once and compares all of them against h2 with SIMD :
+//   AVX2   32 bytes per compare (_mm256_cmpeq_epi8 + movemask)
+//   SSE2   16 bytes (_mm_cmpeq_epi8 + movemask), ie any x86-64
+//   other  portable loop over 16 bytes
+// Only slots whose byte matches get their key compared, ~1 in 128 false positives.
+// Groups are probed triangularly (g, g + 1, g + 3, ...), which visits every group since their
+// count is a power of 2. A probe ends at the first group with an empty slot.
+// Max load is 7/8. Erase leaves a tombstone (deleted) unless the group still has an empty slot,
+// then no probe can have passed it and the slot goes back to empty.
+
+// Values are immutable once inserted : insert() doesn't overwrite an existing key.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace hash_table
+{
+    namespace swiss
+    {
+        constexpr std::int8_t ctrl_empty = -128; // 0b10000000
+        constexpr std::int8_t ctrl_deleted = -2; // 0b11111110
+        // full slots hold h2 in 0..127, ie the sign bit tells free from full
+
+#if defined(__AVX2__)
+        struct group
+        {
+            static constexpr std::size_t width = 32;
+            __m256i ctrl;
+
+            explicit group(const std::int8_t *p) : ctrl{_mm256_load_si256(reinterpret_cast<const __m256i *>(p))} {}
+            std::uint32_t match(std::int8_t h2) const
+            {
+                return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(h2), ctrl)));
+            }
+            std::uint32_t match_empty() const { return match(ctrl_empty); }
+            std::uint32_t match_free() const { return static_cast<std::uint32_t>(_mm256_movemask_epi8(ctrl)); } // empty or deleted
+        };
+#elif defined(__SSE2__)
+        struct group
+        {
+            static constexpr std::size_t width = 16;
+            __m128i ctrl;
+
+            explicit group(const std::int8_t *p) : ctrl{_mm_load_si128(reinterpret_cast<const __m128i *>(p))} {}
+            std::uint32_t match(std::int8_t h2) const
+            {
+                return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+            }
+            std::uint32_t match_empty() const { return match(ctrl_empty); }
+            std::uint32_t match_free() const { return static_cast<std::uint32_t>(_mm_movemask_epi8(ctrl)); }
+        };
+#else
+        struct group
+        {
+            static constexpr std::size_t width = 16;
+            std::int8_t ctrl[width];
+
+            explicit group(const std::int8_t *p) { std::memcpy(ctrl, p, width); }
+            std::uint32_t match(std::int8_t h2) const
+            {
+                std::uint32_t m = 0;
+                for (std::size_t i = 0; i < width; ++i)
+                    m |= std::uint32_t{ctrl[i] == h2} << i;
+                return m;
+            }
+            std::uint32_t match_empty() const { return match(ctrl_empty); }
+            std::uint32_t match_free() const
+            {
+                std::uint32_t m = 0;
+                for (std::size_t i = 0; i < width; ++i)
+                    m |= std::uint32_t{ctrl[i] < 0} << i;
+                return m;
+            }
+        };
+#endif
+    }
+
+    template <typename K, typename V, std::size_t ShardBits = 4, typename Hash = std::hash<K>,
+              typename KeyEqual = std::equal_to<K>, typename Mutex = std::mutex>
+    class sharded_flat_map
+    {
+        static_assert(ShardBits < 16);
+        using group = swiss::group;
+        static constexpr std::size_t npos = ~std::size_t{0};
+
+        struct slot
+        {
+            K key;
+            V value;
+        };
+
+        // Single threaded Swiss table, the shard's mutex guards it
+        class submap
+        {
+            std::int8_t *ctrl{};
+            slot *slots{};
+            std::size_t capacity{}; // 0 or a power of 2 multiple of group::width
+            std::size_t count{};
+            std::size_t growth_left{}; // inserts into empty slots left before the 7/8 load limit
+
+            static std::size_t h2_of(std::size_t h) { return h & 0x7F; }
+
+            static void release(std::int8_t *c, slot *s, std::size_t cap)
+            {
+                if (!cap)
+                    return;
+                for (std::size_t i = 0; i < cap; ++i)
+                    if (c[i] >= 0)
+                        s[i].~slot();
+                ::operator delete(c, std::align_val_t{group::width});
+                ::operator delete(static_cast<void *>(s));
+            }
+
+            // First free slot on key's probe sequence
+            std::size_t free_slot(std::size_t h) const
+            {
+                auto groups_mask = capacity / group::width - 1;
+                auto g = (h >> 7) & groups_mask;
+                for (std::size_t i = 0;; g = (g + ++i) & groups_mask)
+                    if (auto m = group{ctrl + g * group::width}.match_free())
+                        return g * group::width + std::countr_zero(m);
+            }
+
+            void resize(std::size_t new_capacity, const Hash &hasher)
+            {
+                auto old_ctrl = ctrl;
+                auto old_slots = slots;
+                auto old_capacity = capacity;
+                ctrl = static_cast<std::int8_t *>(::operator new(new_capacity, std::align_val_t{group::width}));
+                std::memset(ctrl, swiss::ctrl_empty, new_capacity);
+                slots = static_cast<slot *>(::operator new(new_capacity * sizeof(slot)));
+                capacity = new_capacity;
+                growth_left = capacity - capacity / 8 - count;
+                for (std::size_t i = 0; i < old_capacity; ++i)
+                    if (old_ctrl[i] >= 0)
+                    {
+                        auto h = mix(hasher(old_slots[i].key));
+                        auto j = free_slot(h);
+                        ctrl[j] = static_cast<std::int8_t>(h2_of(h));
+                        new (&slots[j]) slot{std::move(old_slots[i])};
+                    }
+                release(old_ctrl, old_slots, old_capacity);
+            }
+
+        public:
+            submap() = default;
+            submap(const submap &) = delete;
+            submap &operator=(const submap &) = delete;
+            ~submap() { release(ctrl, slots, capacity); }
+
+            std::size_t size() const { return count; }
+
+            std::size_t find(std::size_t h, const K &key, const KeyEqual &eq) const
+            {
+                if (!capacity)
+                    return npos;
+                auto groups_mask = capacity / group::width - 1;
+                auto h2 = static_cast<std::int8_t>(h2_of(h));
+                auto g = (h >> 7) & groups_mask;
+                for (std::size_t i = 0;; g = (g + ++i) & groups_mask)
+                {
+                    group grp{ctrl + g * group::width};
+                    for (auto m = grp.match(h2); m; m &= m - 1)
+                    {
+                        auto idx = g * group::width + std::countr_zero(m);
+                        if (eq(slots[idx].key, key))
+                            return idx;
+                    }
+                    if (grp.match_empty())
+                        return npos;
+                }
+            }
+
+            const V &value(std::size_t idx) const { return slots[idx].value; }
+
+            // key must not be present
+            void insert(std::size_t h, K &&key, V &&value, const Hash &hasher)
+            {
+                if (!growth_left)
+                    // mostly tombstones : clean them up in place, else double
+                    resize(capacity && count < capacity / 2 ? capacity : std::max(2 * capacity, group::width), hasher);
+                auto idx = free_slot(h);
+                if (ctrl[idx] == swiss::ctrl_empty)
+                    --growth_left;
+                ctrl[idx] = static_cast<std::int8_t>(h2_of(h));
+                new (&slots[idx]) slot{std::move(key), std::move(value)};
+                ++count;
+            }
+
+            void erase(std::size_t idx)
+            {
+                slots[idx].~slot();
+                auto g = idx / group::width;
+                if (group{ctrl + g * group::width}.match_empty())
+                {
+                    ctrl[idx] = swiss::ctrl_empty; // no probe went past this group
+                    ++growth_left;
+                }
+                else
+                    ctrl[idx] = swiss::ctrl_deleted;
+                --count;
+            }
+
+            void reserve(std::size_t n, const Hash &hasher)
+            {
+                auto cap = std::max(group::width, std::bit_ceil(n + n / 7 + 1));
+                if (cap > capacity)
+                    resize(cap, hasher);
+            }
+        };
+
+        struct alignas(64) shard
+        {
+            mutable Mutex m;
+            submap map;
+        };
+
+        std::array<shard, std::size_t{1} << ShardBits> shards;
+        [[no_unique_address]] Hash hasher{};
+        [[no_unique_address]] KeyEqual key_eq{};
+
+        // std::hash of an integer is the identity, mix so the top (shard), middle (group) and low
+        // (h2) bits are all random
+        static std::size_t mix(std::size_t x)
+        {
+            std::uint64_t h = x;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return static_cast<std::size_t>(h);
+        }
+        std::size_t hash_of(const K &key) const { return mix(hasher(key)); }
+        shard &shard_of(std::size_t h)
+        {
+            if constexpr (ShardBits == 0)
+                return shards[0];
+            else
+                return shards[h >> (64 - ShardBits)];
+        }
+
+        // shared lock for readers where the mutex has one (eg std::shared_mutex)
+        static auto read_lock(Mutex &m)
+        {
+            if constexpr (requires { m.lock_shared(); })
+                return std::shared_lock{m};
+            else
+                return std::unique_lock{m};
+        }
+
+    public:
+        static constexpr std::size_t shard_count = std::size_t{1} << ShardBits;
+
+        sharded_flat_map() = default;
+        sharded_flat_map(const sharded_flat_map &) = delete;
+        sharded_flat_map &operator=(const sharded_flat_map &) = delete;
+
+        bool insert(K key, V value)
+        {
+            auto h = hash_of(key);
+            auto &s = shard_of(h);
+            std::lock_guard lk{s.m};
+            if (s.map.find(h, key, key_eq) != npos)
+                return false;
+            s.map.insert(h, std::move(key), std::move(value), hasher);
+            return true;
+        }
+
+        bool erase(const K &key)
+        {
+            auto h = hash_of(key);
+            auto &s = shard_of(h);
+            std::lock_guard lk{s.m};
+            auto idx = s.map.find(h, key, key_eq);
+            if (idx == npos)
+                return false;
+            s.map.erase(idx);
+            return true;
+        }
+
+        std::optional<V> find(const K &key)
+        {
+            auto h = hash_of(key);
+            auto &s = shard_of(h);
+            auto lk = read_lock(s.m);
+            auto idx = s.map.find(h, key, key_eq);
+            if (idx == npos)
+                return {};
+            return s.map.value(idx);
+        }
+
+        bool contains(const K &key)
+        {
+            auto h = hash_of(key);
+            auto &s = shard_of(h);
+            auto lk = read_lock(s.m);
+            return s.map.find(h, key, key_eq) != npos;
+        }
+
+        // Room for n elements in total, assuming they spread evenly over the submaps
+        void reserve(std::size_t n)
+        {
+            for (auto &s : shards)
+            {
+                std::lock_guard lk{s.m};
+                s.map.reserve(n / shard_count + 1, hasher);
+            }
+        }
+
+        // Sum over submaps, each locked in turn : exact only when no writer is around
+        std::size_t size() const
+        {
+            std::size_t n = 0;
+            for (auto &s : shards)
+            {
+                std::lock_guard lk{s.m};
+                n += s.map.size();
+            }
+            return n;
+        }
+    };
+}
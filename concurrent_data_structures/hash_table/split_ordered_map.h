@@ -0,0 +1,262 @@
+// Lock-free hash map using split-ordered lists (Shalev and Shavit, "Split-Ordered Lists: Lock-Free Extensible Hash Tables")
+// Built on asp::atomic_shared_ptr (hazard_ptr_asp.h) for memory reclamation
+
+// All elements live in one lock-free sorted linked list. Instead of moving items between buckets
+// on resize, buckets move : a bucket is just a shortcut (a dummy node) into the list.
+// The list is sorted by the bit-reversed hash, so the items of bucket b are contiguous and
+// doubling the table splits every bucket b into b and b + old_size *in place*, by inserting
+// one new dummy node in the middle of b's run. Growing is then a CAS on bucket_count and
+// new buckets get their dummy lazily on first access (from their parent bucket).
+// There is never a stop-the-world rehash.
+
+// Regular keys get the LSB of their split-order key set and dummies don't, so a bucket's
+// dummy sorts before all of its items.
+
+// Deletion (Valois / Michael style, adapted to atomic shared pointers) : since we can't steal
+// a mark bit from atomic_shared_ptr, a node is logically deleted by swinging its next to a
+// marker node (whose next is the old successor). Any CAS on a deleted node's next then fails,
+// so no insert can be lost behind it, and traversals unlink node + marker when they see one.
+
+// Values are immutable once inserted : insert() doesn't overwrite an existing key.
+
+// Readers never write shared memory : find() starts from the bucket's dummy through a raw pointer
+// (dummies live as long as the map) and walks the list hand-over-hand with get_snapshot(), ie
+// hazard pointers only, no ref count increment on any node. Every node's next holds a counted
+// reference to its successor, so a protected node keeps its successor alive, even after both got
+// unlinked. Only insert / erase take owning pointers, for the CASes.
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include "../../atomic_shared_pointers/hazard_ptr_asp.h"
+
+namespace hash_table
+{
+    template <typename K, typename V, typename Hash = std::hash<K>>
+    class split_ordered_map
+    {
+        struct node;
+        using node_ptr = asp::shared_ptr<node>;
+        using node_cb = asp::basic_control_block<node>;
+
+        enum class kind : std::uint8_t
+        {
+            regular,
+            dummy,
+            marker
+        };
+
+        struct node
+        {
+            std::uint64_t so_key{};
+            kind type{};
+            std::optional<std::pair<K, V>> kv{};
+            asp::atomic_shared_ptr<node> next{};
+            node(std::uint64_t so, kind t) : so_key{so}, type{t} {}
+            node(std::uint64_t so, K k, V v) : so_key{so}, type{kind::regular}, kv{std::in_place, std::move(k), std::move(v)} {}
+        };
+
+        static constexpr double max_load = 2.0;
+        static constexpr std::size_t max_segments = 48; // up to 2^47 buckets
+
+        // bucket b lives in segment bit_width(b) : segment 0 holds bucket 0, segment s holds [2^(s-1), 2^s)
+        // segments are allocated on first use and never move
+        // buckets keep raw pointers to dummy ctrl blocks, dummies are never removed from the list
+        std::atomic<std::atomic<node_cb *> *> segments[max_segments]{};
+        std::atomic<std::size_t> bucket_count{2};
+        std::atomic<std::size_t> count{0};
+        Hash hasher{};
+
+        static std::uint64_t reverse(std::uint64_t x)
+        {
+            x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+            x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+            x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+            x = ((x >> 8) & 0x00FF00FF00FF00FFull) | ((x & 0x00FF00FF00FF00FFull) << 8);
+            x = ((x >> 16) & 0x0000FFFF0000FFFFull) | ((x & 0x0000FFFF0000FFFFull) << 16);
+            return (x >> 32) | (x << 32);
+        }
+        static std::uint64_t regular_key(std::uint64_t h) { return reverse(h) | 1; }
+        static std::uint64_t dummy_key(std::uint64_t b) { return reverse(b); }
+
+        std::atomic<node_cb *> &bucket_slot(std::size_t b)
+        {
+            auto s = static_cast<std::size_t>(std::bit_width(b));
+            auto seg = segments[s].load();
+            if (!seg)
+            {
+                std::size_t len = s == 0 ? 1 : std::size_t{1} << (s - 1);
+                auto fresh = new std::atomic<node_cb *>[len] {};
+                if (segments[s].compare_exchange_strong(seg, fresh))
+                    seg = fresh;
+                else
+                    delete[] fresh; // someone else allocated it, seg now holds theirs
+            }
+            return seg[s == 0 ? 0 : b - (std::size_t{1} << (s - 1))];
+        }
+
+        static node_ptr share(node_cb *cb) // dummies are immortal while the map lives
+        {
+            cb->increment_count();
+            return node_ptr{cb};
+        }
+
+        // Finds position for (so_key, key) starting from a bucket's dummy
+        // On return prev->next was curr, and curr is either the match or the first node past it
+        // Returns whether curr matches
+        bool locate(node_ptr start, std::uint64_t so_key, const K *key, node_ptr &prev, node_ptr &curr)
+        {
+        retry:
+            prev = start;
+            curr = prev->next.load();
+            while (curr)
+            {
+                if (curr->type == kind::marker)
+                    goto retry; // prev got deleted after we stepped onto it
+                auto succ = curr->next.load();
+                if (succ && succ->type == kind::marker) // curr is deleted : unlink curr and its marker
+                {
+                    auto after = succ->next.load();
+                    if (!prev->next.compare_exchange_weak(curr, after))
+                        goto retry; // prev changed or got deleted itself
+                    curr = std::move(after);
+                    continue;
+                }
+                if (curr->so_key > so_key)
+                    return false;
+                if (curr->so_key == so_key && (!key || (curr->type == kind::regular && curr->kv->first == *key)))
+                    return true;
+                prev = std::move(curr);
+                curr = std::move(succ);
+            }
+            return false;
+        }
+
+        // Inserts node n unless a node with same (so_key, key) exists
+        // Returns the node which ended up in the list and whether it was n
+        std::pair<node_ptr, bool> list_insert(node_ptr start, node_ptr n)
+        {
+            const K *key = n->type == kind::regular ? &n->kv->first : nullptr;
+            node_ptr prev, curr;
+            while (true)
+            {
+                if (locate(start, n->so_key, key, prev, curr))
+                    return {curr, false};
+                n->next.store(curr);
+                if (prev->next.compare_exchange_weak(curr, n))
+                    return {n, true};
+            }
+        }
+
+        // Raw, uncounted : readers must not write the dummy's count, writers share() it
+        node_cb *bucket(std::size_t b)
+        {
+            auto &slot = bucket_slot(b);
+            if (auto cb = slot.load())
+                return cb;
+            // parent : b with its highest set bit cleared, b's items currently live in parent's run
+            auto parent = bucket(b & ~(std::size_t{1} << (std::bit_width(b) - 1)));
+            auto [dummy, _] = list_insert(share(parent), node_ptr{new node{dummy_key(b), kind::dummy}});
+            node_cb *expected = nullptr;
+            slot.compare_exchange_strong(expected, dummy.control_block); // racers found the same dummy
+            return dummy.control_block; // the list keeps it alive
+        }
+
+        node_cb *bucket_for(std::uint64_t h)
+        {
+            return bucket(h & (bucket_count.load() - 1));
+        }
+
+    public:
+        split_ordered_map()
+        {
+            auto head = node_ptr{new node{dummy_key(0), kind::dummy}};
+            bucket_slot(0).store(head.control_block);
+            head.control_block = nullptr; // list keeps the head alive, released in destructor
+        }
+        split_ordered_map(const split_ordered_map &) = delete;
+        split_ordered_map &operator=(const split_ordered_map &) = delete;
+        ~split_ordered_map()
+        {
+            // unlink iteratively, dropping the head would otherwise destroy the list recursively
+            auto n = node_ptr{bucket_slot(0).load()};
+            while (n)
+            {
+                auto next = n->next.load();
+                n->next.store(node_ptr{});
+                n = std::move(next);
+            }
+            for (auto &seg : segments)
+                delete[] seg.load();
+        }
+
+        bool insert(K key, V value)
+        {
+            auto h = static_cast<std::uint64_t>(hasher(key));
+            auto [_, inserted] = list_insert(share(bucket_for(h)), node_ptr{new node{regular_key(h), std::move(key), std::move(value)}});
+            if (!inserted)
+                return false;
+            auto size = count.fetch_add(1) + 1;
+            auto buckets = bucket_count.load();
+            if (size > max_load * buckets && std::bit_width(buckets) < max_segments)
+                bucket_count.compare_exchange_strong(buckets, 2 * buckets); // lazily split, losing the race is fine
+            return true;
+        }
+
+        // Doesn't unlink deleted nodes like locate does, it steps over them and their markers
+        std::optional<V> find(const K &key)
+        {
+            auto h = static_cast<std::uint64_t>(hasher(key));
+            auto so_key = regular_key(h);
+            auto curr = bucket_for(h)->ptr->next.get_snapshot();
+            while (curr && curr->so_key <= so_key) // a marker has the so_key of the node it deletes
+            {
+                if (curr->type == kind::regular && curr->so_key == so_key && curr->kv->first == key)
+                {
+                    auto succ = curr->next.get_snapshot();
+                    if (succ && succ->type == kind::marker)
+                        return {}; // erased
+                    return curr->kv->second;
+                }
+                curr = curr->next.get_snapshot(); // protects the successor before dropping curr
+            }
+            return {};
+        }
+
+        bool contains(const K &key)
+        {
+            return find(key).has_value();
+        }
+
+        bool erase(const K &key)
+        {
+            auto h = static_cast<std::uint64_t>(hasher(key));
+            auto start = share(bucket_for(h));
+            node_ptr prev, curr;
+            while (true)
+            {
+                if (!locate(start, regular_key(h), &key, prev, curr))
+                    return false;
+                auto succ = curr->next.load();
+                if (succ && succ->type == kind::marker)
+                    continue; // being erased by someone else, locate will help unlink
+                auto marker = node_ptr{new node{curr->so_key, kind::marker}};
+                marker->next.store(succ);
+                if (curr->next.compare_exchange_weak(succ, marker)) // linearization point
+                {
+                    prev->next.compare_exchange_weak(curr, succ); // unlink, else a later traversal does it
+                    count.fetch_sub(1);
+                    return true;
+                }
+            }
+        }
+
+        std::size_t size() const { return count.load(); }
+    };
+}
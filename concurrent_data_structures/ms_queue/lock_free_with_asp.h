@@ -2,69 +2,212 @@
 
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iterator>
 #include <optional>
+#include "../../atomic_shared_pointers/asp_policy.h"
+#include "../../atomic_shared_pointers/contention_stats.h"
+#include "../eventcount.h"
 
 namespace ms_queue
 {
-    template <typename T>
+    // Alloc is used (rebound) for nodes via std::allocate_shared, so node and control block
+    // share one allocation. Pass lock_free::pool_allocator<T> (pool_allocator.h) to recycle nodes
+    // instead of going to the system allocator for every element.
+    // P : pointer policy picking the atomic shared pointer implementation (asp_policy.h)
+    template <typename T, typename Alloc = std::allocator<T>, typename P = asp::std_policy>
     class lf_queue
     {
-        struct node
+        struct node : P::template node_base<node>
         {
             T data{};
-            std::atomic<std::shared_ptr<node>> next{};
+            typename P::template atomic_shared<node> next{};
             node() = default;
             node(T t) : data{std::move(t)} {}
-            node(T t, std::shared_ptr<node> ptr) : data{std::move(t)}, next{std::move(ptr)} {}
+            node(T t, typename P::template shared<node> ptr) : data{std::move(t)}, next{std::move(ptr)} {}
         };
-        std::atomic<std::shared_ptr<node>> head{std::make_shared<node>()};
-        std::atomic<std::shared_ptr<node>> tail{head.load()};
+        using node_ptr = typename P::template shared<node>;
+        using node_alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<node>;
+        [[no_unique_address]] node_alloc alloc{}; // declared before head, used to create the dummy node
+        typename P::template atomic_shared<node> head{P::template allocate<node>(alloc)};
+        typename P::template atomic_shared<node> tail{head.load()};
+        lock_free::eventcount available; // parks dequeue_wait callers, enqueues only pay a fence unless one is parked
 
     public:
         lf_queue() = default;
+        explicit lf_queue(const Alloc &a) : alloc{a} {}
         lf_queue(const lf_queue &) = delete;
         lf_queue &operator=(const lf_queue &) = delete;
-        ~lf_queue() = default;
+        ~lf_queue()
+        {
+            while (dequeue())
+                ;
+            P::retire(head.load()); // the dummy
+        }
         void enqueue(T elem)
         {
-            std::shared_ptr<node> p = std::make_shared<node>(std::move(elem));
-            std::shared_ptr<node> old_tail;
+            node_ptr p = P::template allocate<node>(alloc, std::move(elem));
+            contention::op_scope op{contention::site::queue_enqueue};
+            [[maybe_unused]] typename P::guard g;
+            node_ptr old_tail;
             while (true)
             {
                 old_tail = tail.load();
                 auto old_next = old_tail->next.load();
                 if (old_next) // tail was not pointing to last node
                 {             // swing the tail to next node
-                    tail.compare_exchange_weak(old_tail, old_next);
+                    op.help();
+                    op.cas(tail.compare_exchange_weak(old_tail, old_next));
                     continue;
                 }
                 // old_next is nullptr
-                if (old_tail->next.compare_exchange_strong(old_next, p))
+                if (op.cas(old_tail->next.compare_exchange_strong(old_next, p)))
                     break; // linked node to next of tail successfully
             }
-            tail.compare_exchange_strong(old_tail, p); // swing tail to new node
+            op.cas(tail.compare_exchange_strong(old_tail, p)); // swing tail to new node
+            available.notify_one();
+        }
+
+        // Links [first, last) as one contiguous run : the nodes are chained privately, then a single
+        // CAS on the tail node's next publishes them all, ie the batch linearizes at that CAS
+        // exactly like a single enqueue, and other enqueues can't interleave inside it.
+        template <typename It>
+        void enqueue_bulk(It first, It last)
+        {
+            if (first == last)
+                return;
+            node_ptr chain_first = P::template allocate<node>(alloc, *first);
+            node_ptr chain_last = chain_first;
+            for (++first; first != last; ++first)
+            {
+                node_ptr p = P::template allocate<node>(alloc, *first);
+                chain_last->next.store(p); // not shared yet, nobody else sees these stores
+                chain_last = p;
+            }
+            contention::op_scope op{contention::site::queue_enqueue_bulk};
+            [[maybe_unused]] typename P::guard g;
+            node_ptr old_tail;
+            while (true)
+            {
+                old_tail = tail.load();
+                auto old_next = old_tail->next.load();
+                if (old_next)
+                {
+                    op.help();
+                    op.cas(tail.compare_exchange_weak(old_tail, old_next));
+                    continue;
+                }
+                if (op.cas(old_tail->next.compare_exchange_strong(old_next, chain_first)))
+                    break;
+            }
+            // swing tail straight to the end of the run, if it fails someone already moved it
+            // (helping walks it along the run one node at a time)
+            op.cas(tail.compare_exchange_strong(old_tail, chain_last));
+            available.notify_all();
+        }
+
+        // Dequeues up to max elements into out, returns how many. Moves head over the whole run
+        // with one CAS, so the run is a contiguous prefix taken at that CAS. Head never passes the
+        // tail seen before the CAS (tail only moves forward), same invariant as dequeue().
+        template <typename OutIt>
+        std::size_t dequeue_bulk(OutIt out, std::size_t max)
+        {
+            if (max == 0)
+                return 0;
+            contention::op_scope op{contention::site::queue_dequeue_bulk};
+            [[maybe_unused]] typename P::guard g;
+            node_ptr old_head, new_head;
+            std::size_t n;
+            while (true)
+            {
+                old_head = head.load();
+                auto old_tail = tail.load();
+                new_head = old_head;
+                n = 0;
+                while (n < max && !(new_head == old_tail))
+                {
+                    auto next = new_head->next.load();
+                    if (!next)
+                        break;
+                    new_head = std::move(next);
+                    ++n;
+                }
+                if (n == 0)
+                {
+                    auto old_next = old_head->next.load();
+                    if (!old_next) // empty queue
+                        return 0;
+                    op.help();
+                    op.cas(tail.compare_exchange_strong(old_tail, old_next)); // tail is falling behind
+                    continue;
+                }
+                if (op.cas(head.compare_exchange_strong(old_head, new_head)))
+                    break;
+            }
+            // the run is ours now : old_head keeps it alive (links / guard) and no one reads the data
+            // of nodes before head, so values can be moved out after the CAS
+            auto p = old_head->next.load();
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                *out++ = std::move(p->data);
+                if (i + 1 < n)
+                {
+                    auto next = p->next.load();
+                    P::retire(p); // unlinked along with old_head, last one is the new dummy
+                    p = std::move(next);
+                }
+            }
+            P::retire(old_head);
+            return n;
         }
 
         std::optional<T> dequeue()
         {
-            T result;
+            contention::op_scope op{contention::site::queue_dequeue};
+            [[maybe_unused]] typename P::guard g;
+            node_ptr old_head, old_next;
             while (true)
             {
-                auto old_head = head.load();
+                old_head = head.load();
                 auto old_tail = tail.load();
-                auto old_next = old_head->next.load();
+                old_next = old_head->next.load();
                 if (!old_next) // empty queue
                     return {};
                 if (old_head == old_tail) // tail is falling behind
                 {                         // try to advance tail : helps enqueue
-                    tail.compare_exchange_strong(old_tail, old_next);
+                    op.help();
+                    op.cas(tail.compare_exchange_strong(old_tail, old_next));
                     continue;
                 }
-                result = old_next->data; // read value before moving head, bcoz another dequeue might free old_next
-                if (head.compare_exchange_strong(old_head, old_next))
+                if (op.cas(head.compare_exchange_strong(old_head, old_next)))
                     break; // moved head to next node, dequeue successful
             }
+            // read value only after winning : old_next is held (ref / guard) so it can't be freed, and
+            // as the new dummy its data is never read by anyone else. Reading before the CAS would
+            // race with the winner moving it out (dequeue_bulk).
+            std::optional<T> result{std::move(old_next->data)};
+            P::retire(old_head); // old dummy is unlinked, old_next is the new dummy
             return result;
         }
+
+        // Blocking dequeues : spin on dequeue() a while, then sleep until an enqueue
+        T dequeue_wait()
+        {
+            return std::move(*available.await([this] { return dequeue(); }));
+        }
+
+        // Empty once timeout has passed without an element
+        template <typename Rep, typename Period>
+        std::optional<T> dequeue_wait_for(const std::chrono::duration<Rep, Period> &timeout)
+        {
+            return available.await_for([this] { return dequeue(); }, timeout);
+        }
+
+        template <typename Clock, typename Duration>
+        std::optional<T> dequeue_wait_until(const std::chrono::time_point<Clock, Duration> &deadline)
+        {
+            return available.await_until([this] { return dequeue(); }, deadline);
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,347 @@
+// Wait-free MPMC queue : Kogan and Petrank's wait-free queue ("Wait-free queues with multiple
+// enqueuers and dequeuers", PPoPP 2011) behind a fast path, as in their fast-path-slow-path
+// methodology ("A methodology for creating fast wait-free data structures", PPoPP 2012).
+
+// lf_queue is lock-free only : some thread always makes progress, but a given thread can lose its
+// CAS on head / tail over and over. Here an operation runs the plain MS queue algorithm at most
+// `fast_path_tries` times, then falls back to a slow path :
+//   - it takes a phase number (fetch_add on a counter) and publishes an op descriptor
+//     (phase, pending, enqueue or dequeue, node) in its thread's slot of `state`
+//   - it then helps every pending operation with a phase <= its own, its own included, to
+//     completion. Every thread starting later gets a higher phase and helps ours first, so the
+//     op finishes within a bounded no of steps whatever the scheduling.
+// Fast path threads help too : every `help_delay` operations a thread looks at the next slot of
+// `state` and finishes the op there, if any, so slow ops can't be starved by fast ones.
+
+// Helping is made safe by recording who owns a step in the nodes themselves :
+//   enqueue : the node carries its enqueuer's id (enq_id). Whoever finds it linked after tail
+//             marks that enqueuer's descriptor done, then swings the tail. Tail never passes a
+//             node of a still pending op, so it is never linked twice.
+//   dequeue : the dummy head node is claimed with a CAS on its deq_id, by a slow dequeuer's id or
+//             by `fast_claim` for the fast path. Whoever finds head claimed marks the slow
+//             dequeuer's descriptor done (holding that node), then moves head. Only the claimer
+//             reads the value, from the node after it.
+
+// Nodes and descriptors are reclaimed with epochs (epoch_based_reclamation.h).
+
+// Strictly, allocation (new node / descriptor), the epoch domain's reclamation and the first op
+// of each thread (taking a thread index, under a mutex, thread_index.h) are outside of the
+// wait-free part.
+// Operations from more than MaxThreads threads alive at once throw std::length_error.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include "../../atomic_shared_pointers/epoch_based_reclamation.h"
+#include "../thread_index.h"
+
+namespace ms_queue
+{
+    namespace detail
+    {
+        struct wf_thread
+        {
+            std::size_t id{lock_free::thread_index()};
+            std::size_t next_check{0}; // next slot to look at when helping from the fast path
+            std::size_t ops_until_check{0};
+        };
+
+        inline wf_thread &this_thread()
+        {
+            thread_local wf_thread t;
+            return t;
+        }
+    }
+
+    template <typename T, std::size_t MaxThreads = 128>
+    class wf_queue
+    {
+        static constexpr int no_claim = -1;
+        static constexpr int fast_claim = -2;
+        static constexpr int fast_path_tries = 8;
+        static constexpr std::size_t help_delay = 32;
+
+        struct node
+        {
+            T data{};
+            std::atomic<node *> next{nullptr};
+            int enq_id{-1};                      // slow path enqueuer, -1 for the fast path
+            std::atomic<int> deq_id{no_claim};  // dequeuer owning this node as head
+
+            node() = default;
+            explicit node(T t) : data{std::move(t)} {}
+        };
+
+        // Immutable once published, replaced as a whole by CAS on the thread's slot
+        struct op_desc
+        {
+            std::uint64_t phase;
+            bool pending;
+            bool enqueue;
+            node *n; // enqueue : the node to link, dequeue : the head node claimed (nullptr if empty)
+        };
+
+        struct alignas(64) slot
+        {
+            std::atomic<op_desc *> desc{nullptr}; // nullptr until the thread's first slow op
+        };
+
+        alignas(64) std::atomic<node *> head;
+        alignas(64) std::atomic<node *> tail;
+        alignas(64) std::atomic<std::uint64_t> phase_counter{0};
+        slot state[MaxThreads];
+
+        static std::size_t scan_limit() { return std::min(lock_free::thread_index_high_water(), MaxThreads); }
+
+        bool cas_desc(std::size_t id, op_desc *cur, op_desc *desired)
+        {
+            if (state[id].desc.compare_exchange_strong(cur, desired))
+            {
+                ebr::default_domain().retire(cur);
+                return true;
+            }
+            delete desired;
+            return false;
+        }
+
+        bool still_pending(std::size_t id, std::uint64_t phase)
+        {
+            auto d = state[id].desc.load();
+            return d && d->pending && d->phase <= phase;
+        }
+
+        // Helps every op with a phase <= phase
+        void help(std::uint64_t phase)
+        {
+            for (std::size_t i = 0, n = scan_limit(); i < n; ++i)
+                help_one(i, phase);
+        }
+
+        void help_one(std::size_t id, std::uint64_t phase)
+        {
+            auto d = state[id].desc.load();
+            if (d && d->pending && d->phase <= phase)
+            {
+                if (d->enqueue)
+                    help_enq(id, phase);
+                else
+                    help_deq(id, phase);
+            }
+        }
+
+        // Fast path side of helping : every help_delay ops, finish the op of the next slot if pending
+        void help_if_needed(detail::wf_thread &self)
+        {
+            if (self.ops_until_check-- != 0)
+                return;
+            self.ops_until_check = help_delay;
+            auto n = scan_limit();
+            if (self.next_check >= n)
+                self.next_check = 0;
+            auto id = self.next_check++;
+            if (auto d = state[id].desc.load(); d && d->pending)
+                help_one(id, d->phase);
+        }
+
+        void help_enq(std::size_t id, std::uint64_t phase)
+        {
+            while (still_pending(id, phase))
+            {
+                auto last = tail.load();
+                auto next = last->next.load();
+                if (last != tail.load())
+                    continue;
+                if (next) // tail is falling behind
+                {
+                    help_finish_enq();
+                    continue;
+                }
+                auto d = state[id].desc.load();
+                if (!(d && d->pending && d->phase <= phase))
+                    return;
+                if (last->next.compare_exchange_strong(next, d->n))
+                {
+                    help_finish_enq();
+                    return;
+                }
+            }
+        }
+
+        // The node after tail is linked : mark its slow enqueuer (if any) done, then swing tail
+        void help_finish_enq()
+        {
+            auto last = tail.load();
+            auto next = last->next.load();
+            if (!next)
+                return;
+            if (auto id = next->enq_id; id >= 0)
+            {
+                auto cur = state[id].desc.load();
+                if (last == tail.load() && cur->pending && cur->n == next)
+                    cas_desc(id, cur, new op_desc{cur->phase, false, true, next});
+            }
+            tail.compare_exchange_strong(last, next);
+        }
+
+        void help_deq(std::size_t id, std::uint64_t phase)
+        {
+            while (still_pending(id, phase))
+            {
+                auto first = head.load();
+                auto last = tail.load();
+                auto next = first->next.load();
+                if (first != head.load())
+                    continue;
+                if (first == last)
+                {
+                    if (next) // tail is falling behind
+                    {
+                        help_finish_enq();
+                        continue;
+                    }
+                    // empty : complete the op with no node
+                    auto cur = state[id].desc.load();
+                    if (last == tail.load() && cur->pending && cur->phase <= phase)
+                        cas_desc(id, cur, new op_desc{cur->phase, false, false, nullptr});
+                    continue;
+                }
+                auto cur = state[id].desc.load();
+                if (!(cur->pending && cur->phase <= phase))
+                    return;
+                if (first == head.load() && cur->n != first)
+                {
+                    // record the head we are about to claim before claiming it
+                    if (!cas_desc(id, cur, new op_desc{cur->phase, true, false, first}))
+                        continue;
+                }
+                int expected = no_claim;
+                first->deq_id.compare_exchange_strong(expected, static_cast<int>(id));
+                help_finish_deq();
+            }
+        }
+
+        // Head is claimed : mark its slow dequeuer (if any) done, then move head
+        void help_finish_deq()
+        {
+            auto first = head.load();
+            auto next = first->next.load();
+            auto id = first->deq_id.load();
+            if (id == no_claim || !next)
+                return;
+            if (id >= 0)
+            {
+                auto cur = state[id].desc.load();
+                if (first == head.load() && cur->pending)
+                    cas_desc(id, cur, new op_desc{cur->phase, false, false, cur->n});
+            }
+            if (head.compare_exchange_strong(first, next))
+                ebr::default_domain().retire(first);
+        }
+
+        // Publishes a new descriptor for this thread, then helps up to (and including) it
+        void run_slow(std::size_t id, bool enqueue, node *n)
+        {
+            auto phase = phase_counter.fetch_add(1) + 1;
+            if (auto old = state[id].desc.exchange(new op_desc{phase, true, enqueue, n}))
+                ebr::default_domain().retire(old);
+            help(phase);
+        }
+
+        static detail::wf_thread &self()
+        {
+            auto &t = detail::this_thread();
+            if (t.id >= MaxThreads)
+                throw std::length_error{"ms_queue::wf_queue : more threads than MaxThreads"};
+            return t;
+        }
+
+    public:
+        wf_queue()
+        {
+            auto dummy = new node;
+            head.store(dummy);
+            tail.store(dummy);
+        }
+        wf_queue(const wf_queue &) = delete;
+        wf_queue &operator=(const wf_queue &) = delete;
+        ~wf_queue()
+        {
+            // no other thread is around anymore : nodes before head are retired already
+            for (auto n = head.load(); n;)
+                delete std::exchange(n, n->next.load());
+            for (auto &s : state)
+                delete s.desc.load();
+        }
+
+        void enqueue(T elem)
+        {
+            auto &me = self();
+            ebr::guard g;
+            help_if_needed(me);
+            auto n = new node{std::move(elem)};
+            for (int i = 0; i < fast_path_tries; ++i)
+            {
+                auto last = tail.load();
+                auto next = last->next.load();
+                if (last != tail.load())
+                    continue;
+                if (next)
+                {
+                    help_finish_enq();
+                    continue;
+                }
+                if (last->next.compare_exchange_strong(next, n))
+                {
+                    tail.compare_exchange_strong(last, n);
+                    return;
+                }
+            }
+            n->enq_id = static_cast<int>(me.id); // not shared yet
+            run_slow(me.id, true, n);
+            help_finish_enq(); // our node may still be right after tail
+        }
+
+        std::optional<T> dequeue()
+        {
+            auto &me = self();
+            ebr::guard g;
+            help_if_needed(me);
+            for (int i = 0; i < fast_path_tries; ++i)
+            {
+                auto first = head.load();
+                auto last = tail.load();
+                auto next = first->next.load();
+                if (first != head.load())
+                    continue;
+                if (first == last)
+                {
+                    if (!next)
+                        return {};
+                    help_finish_enq();
+                    continue;
+                }
+                // head only moves past a claimed node, so winning the claim means first is still head
+                int expected = no_claim;
+                if (first->deq_id.compare_exchange_strong(expected, fast_claim))
+                {
+                    help_finish_deq();
+                    // next is the new dummy, its data is read by the claimer only
+                    return std::move(next->data);
+                }
+                help_finish_deq();
+            }
+            run_slow(me.id, false, nullptr);
+            help_finish_deq(); // head moves past our node before we return, see help_finish_deq
+            auto d = state[me.id].desc.load();
+            if (!d->n)
+                return {};
+            return std::move(d->n->next.load()->data);
+        }
+    };
+}
@@ -0,0 +1,181 @@
+// Pooling allocator for node based lock-free structures
+
+// Use with std::allocate_shared so that a node and its control block come out of the pool
+// in one block, eg lf_queue<T, lock_free::pool_allocator<T>>.
+
+// Blocks of one size class are recycled through :
+// - a per-thread cache (plain singly linked list, no atomics on the fast path)
+// - a global lock-free free list of *batches* of blocks shared by all threads
+// A thread whose cache runs dry pops a whole batch and a thread whose cache grows too large
+// pushes a batch back, so the global list is touched once per `batch` operations.
+// Only when the global list is empty is a new slab requested from the system allocator,
+// so once the pool is warmed up allocation and deallocation never reach malloc / free.
+
+// The global list is a Treiber stack, so popping is prone to ABA : between reading head and
+// its next_batch another thread may pop both batches and push the first one back.
+// head is therefore a tagged pointer, 48 bits of address packed with a 16 bit version bumped on
+// every update (assumes 48 bit user-space virtual addresses, true for x86-64 and AArch64 today).
+// A popper may read next_batch of a block that was just handed out. That's harmless since memory
+// is never returned to the system (type-stable) and the stale value fails the CAS anyway.
+
+// Slabs are kept for the lifetime of the process.
+// Blocks must not be deallocated after the deallocating thread's thread_local cache
+// has been destroyed (ie from static destructors).
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace lock_free
+{
+    template <std::size_t Size, std::size_t Align>
+    class block_pool
+    {
+        struct free_block
+        {
+            free_block *next;       // next block in the same batch / cache
+            free_block *next_batch; // only meaningful for the first block of a batch in the global list
+            std::size_t len;        // no of blocks in the batch, likewise
+        };
+
+        static constexpr std::size_t align = Align > alignof(free_block) ? Align : alignof(free_block);
+        static constexpr std::size_t block_size = ((Size > sizeof(free_block) ? Size : sizeof(free_block)) + align - 1) / align * align;
+        static constexpr std::size_t slab_blocks = 256;
+        static constexpr std::size_t batch = 64; // blocks moved between a cache and the global list at a time
+
+        static_assert(sizeof(void *) == 8, "tagged pointer needs 64 bit pointers");
+        static constexpr std::uint64_t addr_mask = (std::uint64_t{1} << 48) - 1;
+
+        static free_block *addr(std::uint64_t w)
+        {
+            return reinterpret_cast<free_block *>(w & addr_mask);
+        }
+        static std::uint64_t bump(std::uint64_t w, free_block *p) // new head word with next version
+        {
+            return reinterpret_cast<std::uint64_t>(p) | ((w & ~addr_mask) + (addr_mask + 1));
+        }
+
+        static inline std::atomic<std::uint64_t> global{0};
+
+        static void push_batch(free_block *first, std::size_t len)
+        {
+            first->len = len;
+            auto h = global.load(std::memory_order_relaxed);
+            do
+            {
+                std::atomic_ref(first->next_batch).store(addr(h), std::memory_order_relaxed);
+            } while (!global.compare_exchange_weak(h, bump(h, first), std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        static free_block *pop_batch()
+        {
+            auto h = global.load(std::memory_order_acquire);
+            while (auto first = addr(h))
+            {
+                auto next = std::atomic_ref(first->next_batch).load(std::memory_order_relaxed);
+                if (global.compare_exchange_weak(h, bump(h, next), std::memory_order_acquire, std::memory_order_acquire))
+                    return first;
+            }
+            return nullptr;
+        }
+
+        struct local_cache
+        {
+            free_block *head{};
+            std::size_t count{};
+
+            ~local_cache() // hand everything back on thread exit
+            {
+                if (head)
+                    push_batch(head, count);
+            }
+
+            void refill()
+            {
+                if ((head = pop_batch()))
+                {
+                    count = head->len;
+                    return;
+                }
+                // pool exhausted : carve a new slab into blocks
+                auto slab = static_cast<std::byte *>(::operator new(block_size * slab_blocks, std::align_val_t{align}));
+                for (std::size_t i = slab_blocks; i-- > 0;)
+                {
+                    auto b = reinterpret_cast<free_block *>(slab + i * block_size);
+                    b->next = head;
+                    head = b;
+                }
+                count = slab_blocks;
+            }
+
+            void flush_batch()
+            {
+                auto first = head, last = head;
+                for (std::size_t i = 1; i < batch; ++i)
+                    last = last->next;
+                head = last->next;
+                last->next = nullptr;
+                count -= batch;
+                push_batch(first, batch);
+            }
+        };
+
+        static local_cache &cache()
+        {
+            thread_local local_cache c;
+            return c;
+        }
+
+    public:
+        static void *allocate()
+        {
+            auto &c = cache();
+            if (!c.head)
+                c.refill();
+            auto b = c.head;
+            c.head = b->next;
+            --c.count;
+            return b;
+        }
+
+        static void deallocate(void *p) noexcept
+        {
+            auto &c = cache();
+            auto b = static_cast<free_block *>(p);
+            b->next = c.head;
+            c.head = b;
+            if (++c.count >= 2 * batch)
+                c.flush_batch();
+        }
+    };
+
+    template <typename T>
+    struct pool_allocator
+    {
+        using value_type = T;
+
+        pool_allocator() = default;
+        template <typename U>
+        pool_allocator(const pool_allocator<U> &) noexcept {}
+
+        T *allocate(std::size_t n)
+        {
+            if (n != 1) // pool only serves single objects
+                return std::allocator<T>{}.allocate(n);
+            return static_cast<T *>(block_pool<sizeof(T), alignof(T)>::allocate());
+        }
+
+        void deallocate(T *p, std::size_t n) noexcept
+        {
+            if (n != 1)
+                return std::allocator<T>{}.deallocate(p, n);
+            block_pool<sizeof(T), alignof(T)>::deallocate(p);
+        }
+
+        friend bool operator==(const pool_allocator &, const pool_allocator &) noexcept { return true; }
+    };
+}
@@ -0,0 +1,188 @@
+// Bounded MPMC queue over a ring buffer with per-slot sequence numbers (Dmitry Vyukov's design)
+
+// Capacity is fixed at construction (rounded up to a power of two), no allocation afterwards
+// and slots are contiguous, so producers and consumers walk memory sequentially.
+
+// Each slot carries a sequence number telling which lap of the ring it is ready for :
+//   seq == pos           slot free, the producer claiming position pos may write it
+//   seq == pos + 1       slot full, the consumer claiming position pos may read it
+//   seq == pos + cap     slot freed again by that consumer, ready for the next lap
+// Producers and consumers claim positions by CAS on enqueue_pos / dequeue_pos and then publish
+// the slot with a release store of its seq. A producer never waits for a consumer (or vice versa) :
+// if the slot isn't ready yet the queue is reported full (empty).
+
+// Batch operations check up to N consecutive slots first and claim all ready ones with a
+// single CAS. Once the seq of a slot matches, only the claimant of that position can change it,
+// so a successful CAS from pos to pos + k hands over all k slots.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+namespace ring_buffer
+{
+    template <typename T>
+    class mpmc_ring
+    {
+        struct slot
+        {
+            std::atomic<std::size_t> seq;
+            alignas(T) unsigned char storage[sizeof(T)];
+            T *get() { return std::launder(reinterpret_cast<T *>(storage)); }
+        };
+
+        std::size_t mask;
+        std::unique_ptr<slot[]> slots;
+        alignas(64) std::atomic<std::size_t> enqueue_pos{0}; // producers and consumers on separate lines
+        alignas(64) std::atomic<std::size_t> dequeue_pos{0};
+
+        static std::size_t round_up_pow2(std::size_t n)
+        {
+            std::size_t cap = 2;
+            while (cap < n)
+                cap <<= 1;
+            return cap;
+        }
+
+        static std::ptrdiff_t diff(std::size_t a, std::size_t b)
+        {
+            return static_cast<std::ptrdiff_t>(a - b);
+        }
+
+        template <typename U>
+        bool emplace(U &&elem)
+        {
+            auto pos = enqueue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                auto &s = slots[pos & mask];
+                auto d = diff(s.seq.load(std::memory_order_acquire), pos);
+                if (d == 0)
+                {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        ::new (s.storage) T(std::forward<U>(elem));
+                        s.seq.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (d < 0) // slot still holds an element from the previous lap
+                    return false;
+                else // another producer claimed pos
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+    public:
+        explicit mpmc_ring(std::size_t capacity) : mask{round_up_pow2(capacity) - 1}, slots{new slot[mask + 1]}
+        {
+            for (std::size_t i = 0; i <= mask; ++i)
+                slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+        mpmc_ring(const mpmc_ring &) = delete;
+        mpmc_ring &operator=(const mpmc_ring &) = delete;
+        ~mpmc_ring()
+        {
+            while (try_dequeue())
+                ;
+        }
+
+        std::size_t capacity() const { return mask + 1; }
+
+        bool try_enqueue(const T &elem) { return emplace(elem); }
+        bool try_enqueue(T &&elem) { return emplace(std::move(elem)); }
+
+        std::optional<T> try_dequeue()
+        {
+            auto pos = dequeue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                auto &s = slots[pos & mask];
+                auto d = diff(s.seq.load(std::memory_order_acquire), pos + 1);
+                if (d == 0)
+                {
+                    if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        std::optional<T> result{std::move(*s.get())};
+                        s.get()->~T();
+                        s.seq.store(pos + mask + 1, std::memory_order_release);
+                        return result;
+                    }
+                }
+                else if (d < 0) // slot not yet written
+                    return {};
+                else
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Moves up to n elements from [first, first + n) into the queue
+        // Returns how many were enqueued (only a prefix is consumed)
+        template <typename It>
+        std::size_t try_enqueue_bulk(It first, std::size_t n)
+        {
+            auto pos = enqueue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                std::size_t k = 0;
+                while (k < n && k <= mask && slots[(pos + k) & mask].seq.load(std::memory_order_acquire) == pos + k)
+                    ++k;
+                if (k == 0)
+                {
+                    if (diff(slots[pos & mask].seq.load(std::memory_order_acquire), pos) < 0)
+                        return 0; // full
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (enqueue_pos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed))
+                {
+                    for (std::size_t i = 0; i < k; ++i, ++first)
+                    {
+                        auto &s = slots[(pos + i) & mask];
+                        ::new (s.storage) T(std::move(*first));
+                        s.seq.store(pos + i + 1, std::memory_order_release);
+                    }
+                    return k;
+                }
+            }
+        }
+
+        // Moves up to max elements out of the queue into out
+        // Returns how many were dequeued
+        template <typename OutIt>
+        std::size_t try_dequeue_bulk(OutIt out, std::size_t max)
+        {
+            auto pos = dequeue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                std::size_t k = 0;
+                while (k < max && k <= mask && slots[(pos + k) & mask].seq.load(std::memory_order_acquire) == pos + k + 1)
+                    ++k;
+                if (k == 0)
+                {
+                    if (diff(slots[pos & mask].seq.load(std::memory_order_acquire), pos + 1) < 0)
+                        return 0; // empty
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (dequeue_pos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed))
+                {
+                    for (std::size_t i = 0; i < k; ++i, ++out)
+                    {
+                        auto &s = slots[(pos + i) & mask];
+                        *out = std::move(*s.get());
+                        s.get()->~T();
+                        s.seq.store(pos + i + mask + 1, std::memory_order_release);
+                    }
+                    return k;
+                }
+            }
+        }
+    };
+}
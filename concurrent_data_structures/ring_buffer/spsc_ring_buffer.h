@@ -0,0 +1,151 @@
+// Bounded single producer / single consumer queue over a ring buffer (Lamport's queue, with
+// cached indices as in folly::ProducerConsumerQueue / rigtorp::SPSCQueue)
+
+// With one thread on each side nothing needs a CAS : the producer alone writes tail, the
+// consumer alone writes head, and each publishes with a release store that the other side
+// picks up with an acquire load. No per-slot sequence numbers either.
+
+// head and tail sit on separate cache lines. Each side also keeps a plain copy of the other
+// side's index on its own line and only reloads the shared one when the copy says full (empty).
+// As long as the queue is neither, producer and consumer don't touch each other's lines at all.
+
+// Batch variants move as many elements as fit with a single index update.
+
+// One producer thread and one consumer thread at a time, anything else is a data race.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+namespace ring_buffer
+{
+    template <typename T>
+    class spsc_ring
+    {
+        struct slot
+        {
+            alignas(T) unsigned char storage[sizeof(T)];
+            T *get() { return std::launder(reinterpret_cast<T *>(storage)); }
+        };
+
+        std::size_t mask;
+        std::unique_ptr<slot[]> slots;
+        // consumer side
+        alignas(64) std::atomic<std::size_t> head{0};
+        std::size_t cached_tail{0};
+        // producer side
+        alignas(64) std::atomic<std::size_t> tail{0};
+        std::size_t cached_head{0};
+        alignas(64) char pad{}; // keeps whatever follows off the producer's line
+
+        static std::size_t round_up_pow2(std::size_t n)
+        {
+            std::size_t cap = 2;
+            while (cap < n)
+                cap <<= 1;
+            return cap;
+        }
+
+        // free slots as seen by the producer at position t, refreshing cached_head if short of want
+        std::size_t free_slots(std::size_t t, std::size_t want)
+        {
+            auto free = capacity() - (t - cached_head);
+            if (free < want)
+            {
+                cached_head = head.load(std::memory_order_acquire);
+                free = capacity() - (t - cached_head);
+            }
+            return free;
+        }
+
+        // ready elements as seen by the consumer at position h, refreshing cached_tail if short of want
+        std::size_t ready_slots(std::size_t h, std::size_t want)
+        {
+            auto ready = cached_tail - h;
+            if (ready < want)
+            {
+                cached_tail = tail.load(std::memory_order_acquire);
+                ready = cached_tail - h;
+            }
+            return ready;
+        }
+
+        template <typename U>
+        bool emplace(U &&elem)
+        {
+            auto t = tail.load(std::memory_order_relaxed);
+            if (free_slots(t, 1) == 0)
+                return false;
+            ::new (slots[t & mask].storage) T(std::forward<U>(elem));
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+    public:
+        explicit spsc_ring(std::size_t capacity) : mask{round_up_pow2(capacity) - 1}, slots{new slot[mask + 1]} {}
+        spsc_ring(const spsc_ring &) = delete;
+        spsc_ring &operator=(const spsc_ring &) = delete;
+        ~spsc_ring()
+        {
+            while (try_dequeue())
+                ;
+        }
+
+        std::size_t capacity() const { return mask + 1; }
+
+        // Producer side
+        bool try_enqueue(const T &elem) { return emplace(elem); }
+        bool try_enqueue(T &&elem) { return emplace(std::move(elem)); }
+
+        // Consumer side
+        std::optional<T> try_dequeue()
+        {
+            auto h = head.load(std::memory_order_relaxed);
+            if (ready_slots(h, 1) == 0)
+                return {};
+            auto &s = slots[h & mask];
+            std::optional<T> result{std::move(*s.get())};
+            s.get()->~T();
+            head.store(h + 1, std::memory_order_release);
+            return result;
+        }
+
+        // Producer side : moves up to n elements from [first, first + n) into the queue
+        // Returns how many were enqueued (only a prefix is consumed)
+        template <typename It>
+        std::size_t try_enqueue_bulk(It first, std::size_t n)
+        {
+            auto t = tail.load(std::memory_order_relaxed);
+            auto k = std::min(n, free_slots(t, n));
+            for (std::size_t i = 0; i < k; ++i, ++first)
+                ::new (slots[(t + i) & mask].storage) T(std::move(*first));
+            if (k)
+                tail.store(t + k, std::memory_order_release);
+            return k;
+        }
+
+        // Consumer side : moves up to max elements out of the queue into out
+        // Returns how many were dequeued
+        template <typename OutIt>
+        std::size_t try_dequeue_bulk(OutIt out, std::size_t max)
+        {
+            auto h = head.load(std::memory_order_relaxed);
+            auto k = std::min(max, ready_slots(h, max));
+            for (std::size_t i = 0; i < k; ++i, ++out)
+            {
+                auto &s = slots[(h + i) & mask];
+                *out = std::move(*s.get());
+                s.get()->~T();
+            }
+            if (k)
+                head.store(h + k, std::memory_order_release);
+            return k;
+        }
+    };
+}
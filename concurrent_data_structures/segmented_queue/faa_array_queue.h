@@ -0,0 +1,173 @@
+// Unbounded MPMC queue over a linked list of array segments (FAAArrayQueue, in the LCRQ family)
+
+// ms_queue::lf_queue has every enqueuer CAS the same tail (and every dequeuer the same head) :
+// under contention most of them fail, and each failure costs a cache line transfer for nothing.
+// Here threads claim slots with fetch_add on per-segment indices instead, which always succeeds,
+// so n contending threads cost n RMWs instead of O(n^2) failed CASes. CAS is left for the rare
+// segment switch.
+
+// Each segment holds `SegmentSize` slots, enqidx / deqidx are bumped with fetch_add :
+//   enqueue : i = enqidx++, write the value into slot i then publish it (empty -> full CAS)
+//   dequeue : i = deqidx++, if slot i is still empty mark it taken (empty -> taken CAS), ie its
+//             enqueuer is late : it sees the CAS fail, takes its value back and claims another slot.
+//             Otherwise slot i is full and belongs to us alone.
+// An enqueuer running past the end of its segment appends a new one (with its value already in
+// slot 0) via CAS on next. A dequeuer running past the end moves head to the next segment and
+// retires the old one.
+
+// Segments are reclaimed with hazard pointers (hazard_pointers.h) : every operation protects
+// the segment it works on. Head never moves past tail, so a retired segment is unreachable from
+// both.
+
+// Dequeue is lock-free. Enqueue is lock-free in practice : an enqueuer can in theory keep losing
+// its slot to dequeuers running ahead, but every lost slot is a dequeuer finding the queue empty.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <utility>
+#include "../../atomic_shared_pointers/hazard_pointers.h"
+
+namespace segmented_queue
+{
+    template <typename T, std::size_t SegmentSize = 1024>
+    class faa_array_queue
+    {
+        static_assert(SegmentSize > 1);
+
+        enum : std::uint8_t
+        {
+            empty,
+            full,
+            taken,   // skipped by a dequeuer, its enqueuer has to go elsewhere
+            consumed // value moved out and destroyed
+        };
+
+        struct slot
+        {
+            std::atomic<std::uint8_t> state{empty};
+            alignas(T) unsigned char storage[sizeof(T)];
+            T *get() { return std::launder(reinterpret_cast<T *>(storage)); }
+        };
+
+        struct segment : hazptr::hazptr_obj_base<segment>
+        {
+            alignas(64) std::atomic<std::size_t> enqidx{0};
+            alignas(64) std::atomic<std::size_t> deqidx{0};
+            alignas(64) std::atomic<segment *> next{nullptr};
+            slot slots[SegmentSize];
+
+            segment() = default;
+            // starts with item in slot 0, for the enqueuer appending it
+            explicit segment(T &&item) : enqidx{1}
+            {
+                new (slots[0].storage) T(std::move(item));
+                slots[0].state.store(full, std::memory_order_relaxed);
+            }
+            ~segment()
+            {
+                for (auto &s : slots)
+                    if (s.state.load(std::memory_order_relaxed) == full)
+                        s.get()->~T();
+            }
+        };
+
+        alignas(64) std::atomic<segment *> head;
+        alignas(64) std::atomic<segment *> tail;
+
+    public:
+        faa_array_queue()
+        {
+            auto s = new segment;
+            head.store(s);
+            tail.store(s);
+        }
+        faa_array_queue(const faa_array_queue &) = delete;
+        faa_array_queue &operator=(const faa_array_queue &) = delete;
+        ~faa_array_queue()
+        {
+            // no other thread is around anymore : segments before head are retired already
+            for (auto s = head.load(); s;)
+                delete std::exchange(s, s->next.load());
+        }
+
+        void enqueue(T item)
+        {
+            auto hp = hazptr::make_hazard_pointer();
+            while (true)
+            {
+                auto seg = hp.protect(tail);
+                auto i = seg->enqidx.fetch_add(1);
+                if (i >= SegmentSize) // segment used up
+                {
+                    if (seg != tail.load())
+                        continue;
+                    auto next = seg->next.load();
+                    if (next) // someone appended already, help move tail
+                    {
+                        tail.compare_exchange_strong(seg, next);
+                        continue;
+                    }
+                    auto fresh = new segment{std::move(item)};
+                    if (seg->next.compare_exchange_strong(next, fresh))
+                    {
+                        tail.compare_exchange_strong(seg, fresh);
+                        return;
+                    }
+                    // lost the append : take the item back and go with the winner's segment
+                    item = std::move(*fresh->slots[0].get());
+                    delete fresh;
+                    continue;
+                }
+                auto &s = seg->slots[i];
+                new (s.storage) T(std::move(item));
+                std::uint8_t expected = empty;
+                if (s.state.compare_exchange_strong(expected, full))
+                    return;
+                // a dequeuer gave up on this slot, it is never read : take the item back, retry
+                item = std::move(*s.get());
+                s.get()->~T();
+            }
+        }
+
+        std::optional<T> dequeue()
+        {
+            auto hp = hazptr::make_hazard_pointer();
+            while (true)
+            {
+                auto seg = hp.protect(head);
+                // cheap emptiness check first, so idle dequeuers don't burn slots
+                if (seg->deqidx.load() >= seg->enqidx.load() && !seg->next.load())
+                    return {};
+                auto i = seg->deqidx.fetch_add(1);
+                if (i >= SegmentSize) // segment drained, move on to the next one
+                {
+                    auto next = seg->next.load();
+                    if (!next)
+                        return {};
+                    auto old_tail = seg;
+                    tail.compare_exchange_strong(old_tail, next); // head must not pass tail
+                    if (head.compare_exchange_strong(seg, next))
+                    {
+                        hp.reset_protection();
+                        seg->retire();
+                    }
+                    continue;
+                }
+                auto &s = seg->slots[i];
+                std::uint8_t expected = empty;
+                if (s.state.compare_exchange_strong(expected, taken))
+                    continue; // enqueuer of slot i not there yet, it will find the slot taken
+                // expected == full : slot i is ours alone
+                std::optional<T> result{std::move(*s.get())};
+                s.get()->~T();
+                s.state.store(consumed, std::memory_order_relaxed);
+                return result;
+            }
+        }
+    };
+}
@@ -0,0 +1,447 @@
+// Lock-free ordered map : skip list in the style of Fraser / Herlihy & Shavit (The Art of
+// Multiprocessor Programming, LockFreeSkipList), with hazard pointers (hazard_pointers.h) for
+// memory reclamation
+
+// Every node sits in the level 0 list, sorted by key, and with probability 1/4 per level also in
+// the lists above it, so a search skips over most of the map from the top level down.
+// The level 0 list is the map : a node is in the map iff it is linked and unmarked there.
+
+// Links carry a mark bit (the LSB of the next pointer). erase() marks the victim's links top down,
+// level 0 last, which is the linearization point. A marked link never changes again, so no CAS can
+// link anything behind a node being erased. Every search unlinks (snips) the marked nodes it
+// walks over, level by level, and restarts from the top if its predecessor got marked under it.
+// insert() links level 0 first (its linearization point), then the levels above one by one,
+// giving up on them once the node is marked.
+
+// Reclamation : a searcher holds hazards on its predecessor and current node at each level, and
+// only steps onto a node after publishing it and checking that the predecessor still points to it
+// unmarked (a marked predecessor means restart). Unlike a list there's no single unlink : insert
+// may still be linking upper levels of a node erase() has marked. So the inserter and the eraser
+// each run a search for the key once they are done (which snips the node wherever it's still
+// linked) and the last of the two retires it. Searches keep preds / succs of the levels an insert
+// needs protected, which takes up to 2 * max_level + 3 hazard records per thread, held in a
+// thread_local set for the thread's lifetime.
+
+// Iterators hold a hazard on their node, so they stay valid across concurrent erases. They are
+// weakly consistent : stepping from an erased node resumes after its key, elements inserted or
+// erased during iteration may or may not be seen. An iterator must not outlive its map.
+
+// Values are immutable once inserted : insert() doesn't overwrite an existing key.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <utility>
+#include "../../atomic_shared_pointers/hazard_pointers.h"
+
+namespace skip_list
+{
+    template <typename K, typename V, typename Compare = std::less<K>>
+    class skip_list_map
+    {
+    public:
+        static constexpr int max_level = 16; // p = 1/4, fine up to ~4^16 elements
+
+    private:
+        using link = std::atomic<std::uintptr_t>;
+
+        // the tower of `height` links follows the node in the same allocation
+        struct node : hazptr::hazptr_obj
+        {
+            std::pair<const K, V> kv;
+            const int height;
+            std::atomic<int> owners{2}; // inserter and eraser, the last one done retires the node
+
+            node(int h, K k, V v) : kv{std::move(k), std::move(v)}, height{h} {}
+            link *tower() { return reinterpret_cast<link *>(this + 1); }
+        };
+        static_assert(alignof(node) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ && alignof(node) >= alignof(link));
+
+        static node *create(int h, K k, V v)
+        {
+            auto n = new (::operator new(sizeof(node) + h * sizeof(link))) node{h, std::move(k), std::move(v)};
+            for (int l = 0; l < h; ++l)
+                new (&n->tower()[l]) link{0};
+            return n;
+        }
+        static void destroy(node *n)
+        {
+            n->~node();
+            ::operator delete(static_cast<void *>(n));
+        }
+
+        static bool marked(std::uintptr_t w) { return w & 1; }
+        static node *ptr_of(std::uintptr_t w) { return reinterpret_cast<node *>(w & ~std::uintptr_t{1}); }
+        static std::uintptr_t raw(node *n) { return reinterpret_cast<std::uintptr_t>(n); }
+
+        // Hazard records for one search, per thread. Slots are handed out from a bitmask :
+        // `owned` ones hold preds / succs the caller still needs, the rest are recycled as the
+        // search moves on
+        struct hazard_slots
+        {
+            static constexpr int count = 2 * max_level + 3;
+            static_assert(count <= 64);
+
+            hazptr::hazptr_holder h[count];
+            std::uint64_t used{}, owned{};
+
+            hazard_slots()
+            {
+                for (auto &s : h)
+                    s = hazptr::make_hazard_pointer();
+            }
+            int alloc()
+            {
+                auto s = std::countr_one(used);
+                assert(s < count);
+                used |= std::uint64_t{1} << s;
+                return s;
+            }
+            void free(int s)
+            {
+                if (s >= 0 && !(owned >> s & 1))
+                    used &= ~(std::uint64_t{1} << s);
+            }
+            void keep(int s)
+            {
+                if (s >= 0)
+                    owned |= std::uint64_t{1} << s;
+            }
+            void reset(std::uint64_t reserved) { used = owned = reserved; }
+            void clear() // end of operation : drop every hazard
+            {
+                for (auto m = used; m; m &= m - 1)
+                    h[std::countr_zero(m)].reset_protection();
+                used = owned = 0;
+            }
+        };
+        static hazard_slots &slots()
+        {
+            thread_local hazard_slots s;
+            return s;
+        }
+
+        alignas(64) link head[max_level]{};
+        std::atomic<int> levels{1}; // no of levels in use
+        std::atomic<std::size_t> count{0};
+        [[no_unique_address]] Compare less_than{};
+
+        bool less(const K &a, const K &b) const { return less_than(a, b); }
+        link &next_of(node *pred, int l) { return pred ? pred->tower()[l] : head[l]; } // nullptr is head
+
+        static int random_height()
+        {
+            thread_local std::uint64_t x = 0x9E3779B97F4A7C15ull ^ reinterpret_cast<std::uintptr_t>(&x);
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            return std::min(max_level, 1 + std::countr_zero(x) / 2);
+        }
+
+        // Publishes pred's successor at level l in h and checks pred still points to it
+        // Returns false if pred got marked : the caller restarts from the top
+        bool protect_next(hazptr::hazptr_holder &h, node *pred, int l, node *&out)
+        {
+            auto &src = next_of(pred, l);
+            auto w = src.load(std::memory_order_acquire);
+            while (true)
+            {
+                if (marked(w))
+                    return false;
+                h.reset_protection(ptr_of(w));
+                auto again = src.load(std::memory_order_acquire);
+                if (again == w)
+                {
+                    out = ptr_of(w);
+                    return true;
+                }
+                w = again;
+            }
+        }
+
+        // Top-down search, snipping marked nodes on the way (Herlihy & Shavit's find)
+        // Returns the first level 0 node not before key (after key if `after`), protected in *slot
+        // For levels below keep, preds[l] / succs[l] are the last node before and the first node not
+        // before key at level l, left protected till the next search or slots().clear()
+        // `reserved` slots are left alone
+        node *search(const K &key, int keep, node **preds, node **succs, int *slot = nullptr,
+                     std::uint64_t reserved = 0, bool after = false)
+        {
+            auto &hs = slots();
+            node *curr = nullptr;
+            int cs = -1;
+        retry:
+            hs.reset(reserved);
+            node *pred = nullptr;
+            int ps = -1;
+            for (int l = std::max(levels.load(std::memory_order_relaxed), keep) - 1; l >= 0; --l)
+            {
+                cs = hs.alloc();
+                if (!protect_next(hs.h[cs], pred, l, curr))
+                    goto retry;
+                while (curr)
+                {
+                    auto succ = curr->tower()[l].load(std::memory_order_acquire);
+                    if (marked(succ)) // curr is being erased : unlink it at this level
+                    {
+                        auto expected = raw(curr);
+                        if (!next_of(pred, l).compare_exchange_strong(expected, succ & ~std::uintptr_t{1}))
+                            goto retry;
+                        if (!protect_next(hs.h[cs], pred, l, curr))
+                            goto retry;
+                        continue;
+                    }
+                    if (after ? less(key, curr->kv.first) : !less(curr->kv.first, key))
+                        break;
+                    hs.free(ps);
+                    pred = curr;
+                    ps = cs;
+                    cs = hs.alloc();
+                    if (!protect_next(hs.h[cs], pred, l, curr))
+                        goto retry;
+                }
+                if (l < keep)
+                {
+                    preds[l] = pred;
+                    succs[l] = curr;
+                    hs.keep(ps);
+                    hs.keep(cs);
+                }
+                else if (l > 0)
+                    hs.free(cs);
+            }
+            if (slot)
+                *slot = cs;
+            return curr;
+        }
+
+        // Inserter and eraser each call this once when done with n
+        static void release(node *n)
+        {
+            if (n->owners.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                n->addr = n;
+                n->reclaim = [](hazptr::hazptr_obj *obj)
+                { destroy(static_cast<node *>(obj)); };
+                hazptr::default_domain().retire(n);
+            }
+        }
+
+    public:
+        class iterator
+        {
+            friend class skip_list_map;
+            skip_list_map *map{};
+            node *curr{};
+            hazptr::hazptr_holder curr_h, next_h; // curr, and whatever we're moving onto
+
+            explicit iterator(skip_list_map *m) : map{m}, curr_h{hazptr::make_hazard_pointer()}, next_h{hazptr::make_hazard_pointer()} {}
+
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = std::pair<const K, V>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type *;
+            using reference = const value_type &;
+
+            iterator() = default; // end
+            iterator(iterator &&) noexcept = default;
+            iterator &operator=(iterator &&) noexcept = default;
+
+            reference operator*() const { return curr->kv; }
+            pointer operator->() const { return &curr->kv; }
+            iterator &operator++()
+            {
+                map->step(*this);
+                map->skip_erased(*this);
+                return *this;
+            }
+            friend bool operator==(const iterator &a, const iterator &b) { return a.curr == b.curr; }
+        };
+
+    private:
+        // Moves it to the first node not before key (after key if `after`)
+        void seek(iterator &it, const K &key, bool after)
+        {
+            node *preds[1], *succs[1];
+            while (true)
+            {
+                auto n = search(key, 1, preds, succs, nullptr, 0, after);
+                it.next_h.reset_protection(n);
+                bool linked = next_of(preds[0], 0).load(std::memory_order_acquire) == raw(n);
+                slots().clear();
+                if (linked)
+                {
+                    it.curr_h.swap(it.next_h);
+                    it.curr = n;
+                    return;
+                }
+            }
+        }
+
+        void step(iterator &it)
+        {
+            node *next;
+            if (protect_next(it.next_h, it.curr, 0, next))
+            {
+                it.curr_h.swap(it.next_h);
+                it.curr = next;
+            }
+            else // curr got erased, its links can't be trusted anymore
+                seek(it, it.curr->kv.first, true);
+        }
+
+        void skip_erased(iterator &it)
+        {
+            while (it.curr && marked(it.curr->tower()[0].load(std::memory_order_acquire)))
+                step(it);
+        }
+
+    public:
+        skip_list_map() = default;
+        skip_list_map(const skip_list_map &) = delete;
+        skip_list_map &operator=(const skip_list_map &) = delete;
+        ~skip_list_map()
+        {
+            // no operation in flight : every erased node is unlinked and retired already
+            for (auto w = head[0].load(); ptr_of(w);)
+            {
+                auto n = ptr_of(w);
+                w = n->tower()[0].load();
+                destroy(n);
+            }
+        }
+
+        bool insert(K key, V value)
+        {
+            auto h = random_height();
+            auto top = levels.load(std::memory_order_relaxed);
+            while (top < h && !levels.compare_exchange_weak(top, h, std::memory_order_relaxed))
+                ;
+            auto n = create(h, std::move(key), std::move(value));
+            const K &k = n->kv.first;
+            node *preds[max_level], *succs[max_level];
+            while (true)
+            {
+                auto found = search(k, h, preds, succs);
+                if (found && !less(k, found->kv.first))
+                {
+                    slots().clear();
+                    destroy(n);
+                    return false;
+                }
+                for (int l = 0; l < h; ++l)
+                    n->tower()[l].store(raw(succs[l]), std::memory_order_relaxed);
+                auto expected = raw(succs[0]);
+                if (next_of(preds[0], 0).compare_exchange_strong(expected, raw(n))) // linearization point
+                    break;
+            }
+            count.fetch_add(1, std::memory_order_relaxed);
+
+            for (int l = 1; l < h; ++l)
+            {
+                while (true)
+                {
+                    // n's links only change here and by erase() marking them
+                    auto w = n->tower()[l].load();
+                    if (marked(w) || (ptr_of(w) != succs[l] && !n->tower()[l].compare_exchange_strong(w, raw(succs[l]))))
+                        goto done; // erased meanwhile, stop building
+                    auto expected = raw(succs[l]);
+                    if (next_of(preds[l], l).compare_exchange_strong(expected, raw(n)))
+                        break;
+                    search(k, h, preds, succs);
+                }
+            }
+        done:
+            if (marked(n->tower()[0].load()))
+                search(k, 0, preds, succs); // erased already : unlink it from the levels we just built
+            slots().clear();
+            release(n);
+            return true;
+        }
+
+        bool erase(const K &key)
+        {
+            int slot;
+            auto victim = search(key, 0, nullptr, nullptr, &slot);
+            if (!victim || less(key, victim->kv.first))
+            {
+                slots().clear();
+                return false;
+            }
+            for (int l = victim->height - 1; l > 0; --l)
+            {
+                auto w = victim->tower()[l].load();
+                while (!marked(w) && !victim->tower()[l].compare_exchange_weak(w, w | 1))
+                    ;
+            }
+            auto w = victim->tower()[0].load();
+            do
+            {
+                if (marked(w)) // someone else erased it first
+                {
+                    slots().clear();
+                    return false;
+                }
+            } while (!victim->tower()[0].compare_exchange_weak(w, w | 1)); // linearization point
+            count.fetch_sub(1, std::memory_order_relaxed);
+            search(key, 0, nullptr, nullptr, nullptr, std::uint64_t{1} << slot); // unlink it everywhere
+            slots().clear();
+            release(victim);
+            return true;
+        }
+
+        std::optional<V> find(const K &key)
+        {
+            std::optional<V> result;
+            auto n = search(key, 0, nullptr, nullptr);
+            if (n && !less(key, n->kv.first))
+                result = n->kv.second;
+            slots().clear();
+            return result;
+        }
+
+        bool contains(const K &key)
+        {
+            return find(key).has_value();
+        }
+
+        // First element not before key
+        iterator lower_bound(const K &key)
+        {
+            iterator it{this};
+            seek(it, key, false);
+            skip_erased(it);
+            return it;
+        }
+
+        // First element after key
+        iterator upper_bound(const K &key)
+        {
+            iterator it{this};
+            seek(it, key, true);
+            skip_erased(it);
+            return it;
+        }
+
+        iterator begin()
+        {
+            iterator it{this};
+            protect_next(it.curr_h, nullptr, 0, it.curr); // head is never marked
+            skip_erased(it);
+            return it;
+        }
+        iterator end() { return {}; }
+
+        std::size_t size() const { return count.load(std::memory_order_relaxed); }
+    };
+}
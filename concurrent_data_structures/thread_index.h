@@ -0,0 +1,68 @@
+// Small dense per-thread indices : 0, 1, 2, ... handed out on a thread's first call and given
+// back when it exits, so the next thread reuses the slot. Structures keeping one slot per thread
+// in a fixed array (wf_queue's descriptors, flat combining's publication records) index it with
+// this and only scan up to high_water().
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace lock_free
+{
+    namespace detail
+    {
+        class thread_indices
+        {
+            std::mutex m;
+            std::vector<bool> used;
+            std::atomic<std::size_t> high{0}; // 1 + the largest index ever handed out
+
+        public:
+            std::size_t acquire()
+            {
+                std::lock_guard lk{m};
+                std::size_t i = 0;
+                while (i < used.size() && used[i])
+                    ++i;
+                if (i == used.size())
+                    used.push_back(true);
+                else
+                    used[i] = true;
+                if (i + 1 > high.load(std::memory_order_relaxed))
+                    high.store(i + 1);
+                return i;
+            }
+            void release(std::size_t i)
+            {
+                std::lock_guard lk{m};
+                used[i] = false;
+            }
+            std::size_t high_water() const { return high.load(); }
+        };
+
+        inline thread_indices &indices()
+        {
+            static auto i = new thread_indices; // never destroyed, threads may exit after static destructors
+            return *i;
+        }
+
+        struct thread_index_holder
+        {
+            std::size_t index{indices().acquire()};
+            ~thread_index_holder() { indices().release(index); }
+        };
+    }
+
+    // Index of the calling thread, the first call takes a mutex
+    inline std::size_t thread_index()
+    {
+        thread_local detail::thread_index_holder h;
+        return h.index;
+    }
+
+    // 1 + the largest index handed out so far
+    inline std::size_t thread_index_high_water() { return detail::indices().high_water(); }
+}
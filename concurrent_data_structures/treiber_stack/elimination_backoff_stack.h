@@ -0,0 +1,129 @@
+// Treiber stack with an elimination-backoff layer (Hendler, Shavit, Yerushalmi)
+
+// Under contention most CASes on head fail and each failure bounces head's cache line.
+// A push and a pop that overlap cancel each other anyway, so instead of retrying on head
+// a thread whose CAS failed backs off into a random slot of an elimination array.
+// A pusher parks the address of its value there, a popper that finds it takes the value
+// directly and neither of them touches head again.
+
+// Slot protocol (state is one word) :
+//   EMPTY -> &value   pusher offers its value
+//   &value -> EMPTY   pusher withdraws after timeout (CAS, so it races with a popper)
+//   &value -> BUSY    popper claims the offer and moves the value out
+//   BUSY -> DONE      popper finished, value no longer needed
+//   DONE -> EMPTY     pusher observes the exchange and frees the slot
+// Only the pusher owning the offer resets the slot, so an offer address can't be reused
+// while a popper may still dereference it.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include "stl_lock_free_stack_cpp20.h"
+
+namespace lock_free
+{
+    template <typename T>
+    class EliminationStack
+    {
+        using Node = typename Stack<T>::Node;
+
+        static constexpr std::uintptr_t EMPTY = 0, BUSY = 1, DONE = 2;
+        struct alignas(64) slot // one slot per cache line to avoid false sharing
+        {
+            std::atomic<std::uintptr_t> state{EMPTY};
+        };
+
+        std::atomic<std::shared_ptr<Node>> head;
+        std::size_t width;
+        std::size_t timeout_spins;
+        std::unique_ptr<slot[]> slots;
+
+        slot &random_slot()
+        {
+            // xorshift, seeded per thread
+            thread_local std::uint64_t x = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            return slots[x % width];
+        }
+
+        bool try_eliminate_push(T &value)
+        {
+            auto &s = random_slot();
+            auto offer = reinterpret_cast<std::uintptr_t>(&value);
+            auto expected = EMPTY;
+            if (!s.state.compare_exchange_strong(expected, offer))
+                return false; // slot in use, go back to head
+            for (std::size_t i = 0; i < timeout_spins; ++i)
+            {
+                if (s.state.load() == DONE)
+                {
+                    s.state.store(EMPTY);
+                    return true;
+                }
+            }
+            expected = offer;
+            if (s.state.compare_exchange_strong(expected, EMPTY))
+                return false; // nobody came, offer withdrawn
+            // a popper claimed the offer in the meantime, wait for it to finish moving
+            while (s.state.load() != DONE)
+                ;
+            s.state.store(EMPTY);
+            return true;
+        }
+
+        std::optional<T> try_eliminate_pop()
+        {
+            auto &s = random_slot();
+            for (std::size_t i = 0; i < timeout_spins; ++i)
+            {
+                auto offer = s.state.load();
+                if (offer > DONE && s.state.compare_exchange_strong(offer, BUSY))
+                {
+                    std::optional<T> result{std::move(*reinterpret_cast<T *>(offer))};
+                    s.state.store(DONE);
+                    return result;
+                }
+            }
+            return {};
+        }
+
+    public:
+        // width : no of slots in elimination array (roughly half the contending threads works well)
+        // timeout_spins : how long a thread waits in a slot for a partner before going back to head
+        explicit EliminationStack(std::size_t width_ = 8, std::size_t timeout_spins_ = 256)
+            : width{width_ ? width_ : 1}, timeout_spins{timeout_spins_}, slots{new slot[width]} {}
+        EliminationStack(const EliminationStack &) = delete;
+        EliminationStack &operator=(const EliminationStack &) = delete;
+
+        void push(T t)
+        {
+            auto p = std::make_shared<Node>(std::move(t), head.load());
+            while (!head.compare_exchange_weak(p->next, p))
+            {
+                if (try_eliminate_push(p->t))
+                    return;
+            }
+        }
+
+        std::optional<T> pop()
+        {
+            auto p = head.load();
+            while (p != nullptr)
+            {
+                if (head.compare_exchange_weak(p, p->next))
+                    return {std::move(p->t)};
+                if (auto result = try_eliminate_pop())
+                    return result;
+                p = head.load();
+            }
+            return {};
+        }
+    };
+}
@@ -1,37 +1,77 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <memory>
 #include <optional>
+#include "../../atomic_shared_pointers/asp_policy.h"
+#include "../../atomic_shared_pointers/contention_stats.h"
+#include "../eventcount.h"
 
 namespace lock_free
 {
-    template <typename T>
+    // P : pointer policy picking the atomic shared pointer implementation (asp_policy.h)
+    template <typename T, typename P = asp::std_policy>
     struct Stack
     {
-        struct Node
+        struct Node : P::template node_base<Node>
         {
             T t;
-            std::shared_ptr<Node> next;
-            Node(T elem, std::shared_ptr<Node> ptr) : t{std::move(elem)}, next{std::move(ptr)} {}
+            typename P::template shared<Node> next;
+            Node(T elem, typename P::template shared<Node> ptr) : t{std::move(elem)}, next{std::move(ptr)} {}
         };
-        std::atomic<std::shared_ptr<Node>> head;
+        typename P::template atomic_shared<Node> head;
+        eventcount available; // parks pop_wait callers, push only pays a fence unless one is parked
+
+        Stack() = default;
+        Stack(const Stack &) = delete;
+        Stack &operator=(const Stack &) = delete;
+        ~Stack()
+        {
+            while (pop())
+                ;
+        }
 
         void push(T t)
         {
-            auto p = make_shared<Node>(std::move(t), head.load());
-            while (!head.compare_exchange_weak(p->next, p))
+            contention::op_scope op{contention::site::stack_push};
+            auto p = P::template make<Node>(std::move(t), head.load());
+            while (!op.cas(head.compare_exchange_weak(p->next, p)))
                 ;
+            available.notify_one();
         }
 
         std::optional<T> pop()
         {
+            contention::op_scope op{contention::site::stack_pop};
+            [[maybe_unused]] typename P::guard g; // p->next is read from a node another pop may unlink meanwhile
             auto p = head.load();
-            while (p != nullptr && !head.compare_exchange_weak(p, p->next))
+            while (p && !op.cas(head.compare_exchange_weak(p, p->next)))
                 ;
-            if (p != nullptr)
-                return {std::move(p->t)};
-            return {};
+            if (!p)
+                return {};
+            std::optional<T> result{std::move(p->t)};
+            P::retire(p); // we unlinked it
+            return result;
+        }
+
+        // Blocking pops : spin on pop() a while, then sleep until a push
+        T pop_wait()
+        {
+            return std::move(*available.await([this] { return pop(); }));
+        }
+
+        // Empty once timeout has passed without an element
+        template <typename Rep, typename Period>
+        std::optional<T> pop_wait_for(const std::chrono::duration<Rep, Period> &timeout)
+        {
+            return available.await_for([this] { return pop(); }, timeout);
+        }
+
+        template <typename Clock, typename Duration>
+        std::optional<T> pop_wait_until(const std::chrono::time_point<Clock, Duration> &deadline)
+        {
+            return available.await_until([this] { return pop(); }, deadline);
         }
     };
 }
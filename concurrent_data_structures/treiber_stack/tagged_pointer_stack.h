@@ -0,0 +1,209 @@
+// Treiber stack without reference counting : the head is a versioned (tagged) pointer and nodes
+// are never freed while the stack lives, only recycled. No atomic shared_ptr, no hazard pointers,
+// no epochs : in the steady state push and pop are one CAS each, on the stack's head.
+
+// ABA : a pop reads head = A and A->next = B, gets preempted, meanwhile A is popped, recycled and
+// pushed back. A plain pointer CAS would succeed and install the stale B. Here every successful
+// CAS on a head bumps its tag, so the stale CAS fails. The tag is 32 bits, so it would take 2^32
+// operations on the same head within one pop's read - CAS window to fool it.
+
+// Type-stable memory : a pop may still read A->next after A was popped by another thread. That
+// read has to land on a live node, or it is a use after free. Nodes sit in chunks that are
+// released by the destructor only, so A is still a node (cached, on the free list, or reused) and
+// the garbage next it read is thrown away by the failing CAS. The price : memory is never given
+// back to the allocator, the stack's footprint is its high water mark.
+
+// Recycling : since no node is ever freed, a popped node can go to a private per-thread cache
+// (a slot per thread_index(), thread_index.h) with plain stores. The shared, tagged free list sits
+// behind the caches and moves nodes in chains of `batch` : a thread whose cache is full spills
+// one chain with one CAS, and one with an empty cache takes a whole chain (or `batch` never used
+// indices) at once. So a thread doing pushes and pops touches nothing shared but the stack's head,
+// and a pure producer / consumer pair pays one free list CAS per `batch` nodes. Up to 2 * batch
+// nodes per thread sit in caches. Operations from more than MaxThreads threads alive at once
+// throw std::length_error.
+
+// A 16 byte {pointer, tag} head needs cmpxchg16b, which gcc / clang route through libatomic and
+// don't report as always lock-free. So the "pointer" is a 32 bit index into the chunks instead,
+// and {index, tag} fits in a std::atomic<std::uint64_t>, lock-free on every 64 bit target.
+// Chunk k holds 64 << k nodes, giving room for about 2^32 nodes, and is allocated on first use.
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include "../thread_index.h"
+
+namespace lock_free
+{
+    template <typename T, std::size_t MaxThreads = 128>
+    class tagged_stack
+    {
+        using word = std::uint64_t; // tag << 32 | index, index 0 is the null pointer
+        static_assert(std::atomic<word>::is_always_lock_free, "tagged head needs lock-free 64 bit atomics");
+
+        static constexpr unsigned first_chunk_log = 6; // chunk 0 holds 64 nodes
+        static constexpr unsigned max_chunks = 32 - first_chunk_log;
+        static constexpr std::uint64_t max_index = (std::uint64_t{1} << 32) - (1u << first_chunk_log);
+        static constexpr std::uint32_t batch = 32; // nodes per free list chain
+
+        struct node
+        {
+            std::optional<T> value;             // owned by whoever took the node off a list
+            std::atomic<std::uint32_t> next{0}; // atomic : stale pops may read it while it's rewritten
+            std::uint32_t chain{0};             // rest of the chain, for a chain head on the free list
+        };
+
+        struct list
+        {
+            alignas(64) std::atomic<word> top{0};
+        };
+
+        struct alignas(64) cache // touched by its thread only
+        {
+            std::uint32_t nodes[2 * batch];
+            std::uint32_t count{0};
+        };
+
+        list items;
+        list free; // chain heads, each chain is batch nodes
+        std::atomic<node *> chunks[max_chunks]{};
+        alignas(64) std::atomic<std::uint64_t> fresh{1}; // next never used index
+        cache caches[MaxThreads];
+
+        static std::uint32_t index(word w) { return static_cast<std::uint32_t>(w); }
+        static word bump(word old, std::uint32_t i) { return ((old >> 32) + 1) << 32 | i; }
+
+        // index i lives at offset j - (64 << k) of chunk k, where j = i + 63 and k = log2(j) - 6
+        static std::pair<unsigned, std::size_t> locate(std::uint32_t i)
+        {
+            auto j = std::uint64_t{i} + (1u << first_chunk_log) - 1;
+            unsigned k = std::bit_width(j) - 1 - first_chunk_log;
+            return {k, j - (std::uint64_t{1} << (k + first_chunk_log))};
+        }
+
+        node &at(std::uint32_t i)
+        {
+            auto [k, offset] = locate(i);
+            return chunks[k].load(std::memory_order_acquire)[offset];
+        }
+
+        void push(list &l, std::uint32_t i)
+        {
+            node &n = at(i);
+            word top = l.top.load(std::memory_order_relaxed);
+            do
+                n.next.store(index(top), std::memory_order_relaxed);
+            while (!l.top.compare_exchange_weak(top, bump(top, i), std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        std::uint32_t pop(list &l)
+        {
+            word top = l.top.load(std::memory_order_acquire);
+            // next may come from a node already popped and recycled : then the tag has moved on and the CAS fails
+            while (index(top) && !l.top.compare_exchange_weak(top, bump(top, at(index(top)).next.load(std::memory_order_relaxed)),
+                                                              std::memory_order_acquire, std::memory_order_acquire))
+                ;
+            return index(top);
+        }
+
+        cache &my_cache()
+        {
+            auto t = lock_free::thread_index();
+            if (t >= MaxThreads)
+                throw std::length_error{"lock_free::tagged_stack : more threads than MaxThreads"};
+            return caches[t];
+        }
+
+        void ensure_chunk(std::uint32_t i)
+        {
+            auto k = locate(i).first;
+            if (chunks[k].load(std::memory_order_acquire))
+                return;
+            node *expected = nullptr;
+            node *chunk = new node[std::size_t{1} << (k + first_chunk_log)];
+            if (!chunks[k].compare_exchange_strong(expected, chunk, std::memory_order_acq_rel))
+                delete[] chunk; // someone else allocated it first
+        }
+
+        // Empty cache : take a chain off the free list, else batch never used indices
+        void refill(cache &c)
+        {
+            if (auto i = pop(free))
+            {
+                for (; i; i = at(i).chain)
+                    c.nodes[c.count++] = i;
+                return;
+            }
+            auto first = fresh.fetch_add(batch, std::memory_order_relaxed);
+            if (first + batch - 1 > max_index)
+                throw std::length_error("tagged_stack: out of node indices");
+            for (auto i = first + batch; i-- > first;) // lowest index on top, used first
+            {
+                ensure_chunk(static_cast<std::uint32_t>(i));
+                c.nodes[c.count++] = static_cast<std::uint32_t>(i);
+            }
+        }
+
+        // Full cache : chain the older half and give it to the free list
+        void spill(cache &c)
+        {
+            for (std::uint32_t k = 0; k + 1 < batch; ++k)
+                at(c.nodes[k]).chain = c.nodes[k + 1];
+            at(c.nodes[batch - 1]).chain = 0;
+            push(free, c.nodes[0]);
+            for (std::uint32_t k = 0; k < batch; ++k)
+                c.nodes[k] = c.nodes[k + batch];
+            c.count -= batch;
+        }
+
+        std::uint32_t allocate()
+        {
+            cache &c = my_cache();
+            if (!c.count)
+                refill(c);
+            return c.nodes[--c.count];
+        }
+
+        void recycle(std::uint32_t i)
+        {
+            cache &c = my_cache();
+            if (c.count == 2 * batch)
+                spill(c);
+            c.nodes[c.count++] = i;
+        }
+
+    public:
+        tagged_stack() = default;
+        tagged_stack(const tagged_stack &) = delete;
+        tagged_stack &operator=(const tagged_stack &) = delete;
+        ~tagged_stack()
+        {
+            for (auto &c : chunks)
+                delete[] c.load(std::memory_order_relaxed);
+        }
+
+        void push(T t)
+        {
+            auto i = allocate();
+            at(i).value.emplace(std::move(t));
+            push(items, i);
+        }
+
+        std::optional<T> pop()
+        {
+            auto i = pop(items);
+            if (!i)
+                return {};
+            node &n = at(i);
+            std::optional<T> result{std::move(n.value)};
+            n.value.reset();
+            recycle(i);
+            return result;
+        }
+    };
+}
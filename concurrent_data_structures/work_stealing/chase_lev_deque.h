@@ -0,0 +1,149 @@
+// Chase-Lev work-stealing deque ("Dynamic Circular Work-Stealing Deque", Chase & Lev 2005),
+// with the C11 memory orderings of Le, Pop, Cohen & Zappa Nardelli ("Correct and Efficient
+// Work-Stealing for Weak Memory Models", PPoPP 2013)
+
+// One owner thread pushes and pops at the bottom, any number of thieves steal from the top.
+// The owner's push / pop touch only `bottom` and need no RMW, except pop of the very last element,
+// which races the thieves for it with a CAS on `top`. Thieves always CAS `top`.
+
+//   push  : write the element at bottom, bottom++ (release)
+//   pop   : bottom-- then a seq_cst fence before reading top (store-load : either a thief sees the
+//           smaller bottom or we see its larger top), so owner and thief never both take one element
+//   steal : read top, seq_cst fence, read bottom, read the element at top, CAS top -> top + 1.
+//           A failed CAS means someone else took it : returns nothing, the caller may retry.
+
+// The buffer is a circular array whose size is a power of two. When full, the owner copies the
+// live range [top, bottom) into one twice as big and publishes it. A thief may still be reading
+// the old one, so it is retired through the hazard pointer domain (hazard_pointers.h) and thieves
+// protect the buffer they read from. The owner never needs protection : only it retires buffers.
+// Slots are atomics read / written relaxed : a thief may read a slot the owner is overwriting,
+// its CAS on top then fails and the value is thrown away (but the read itself must not be a race).
+// Hence T must be trivially copyable, in practice a pointer or an index.
+
+// Indices are signed and never wrap in practice (2^63 pushes).
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include "../../atomic_shared_pointers/hazard_pointers.h"
+
+namespace work_stealing
+{
+    template <typename T>
+    class chase_lev_deque
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "slots are std::atomic<T>");
+
+        struct buffer : hazptr::hazptr_obj_base<buffer>
+        {
+            const std::int64_t mask;
+            std::atomic<T> *slots;
+
+            explicit buffer(std::int64_t capacity) : mask{capacity - 1}, slots{new std::atomic<T>[capacity]} {}
+            ~buffer() { delete[] slots; }
+            buffer(const buffer &) = delete;
+            buffer &operator=(const buffer &) = delete;
+
+            std::int64_t capacity() const { return mask + 1; }
+            T get(std::int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+            void put(std::int64_t i, T x) { slots[i & mask].store(x, std::memory_order_relaxed); }
+        };
+
+        alignas(64) std::atomic<std::int64_t> top{0};
+        alignas(64) std::atomic<std::int64_t> bottom{0};
+        std::atomic<buffer *> buf;
+
+        // owner only : copy [t, b) into a buffer twice as big, publish it, retire the old one
+        buffer *grow(buffer *old, std::int64_t t, std::int64_t b)
+        {
+            auto bigger = new buffer{2 * old->capacity()};
+            for (auto i = t; i < b; ++i)
+                bigger->put(i, old->get(i));
+            buf.store(bigger, std::memory_order_release);
+            old->retire();
+            return bigger;
+        }
+
+    public:
+        explicit chase_lev_deque(std::size_t capacity = 1024)
+        {
+            std::size_t cap = 2;
+            while (cap < capacity)
+                cap *= 2;
+            buf.store(new buffer{static_cast<std::int64_t>(cap)}, std::memory_order_relaxed);
+        }
+        ~chase_lev_deque()
+        {
+            delete buf.load(std::memory_order_relaxed);
+        }
+        chase_lev_deque(const chase_lev_deque &) = delete;
+        chase_lev_deque &operator=(const chase_lev_deque &) = delete;
+
+        // Owner only
+        void push(T x)
+        {
+            auto b = bottom.load(std::memory_order_relaxed);
+            auto t = top.load(std::memory_order_acquire);
+            auto a = buf.load(std::memory_order_relaxed);
+            if (b - t > a->mask)
+                a = grow(a, t, b);
+            a->put(b, x);
+            bottom.store(b + 1, std::memory_order_release); // paper : release fence + relaxed store, same code on x86
+        }
+
+        // Owner only, takes the most recently pushed element (LIFO)
+        std::optional<T> pop()
+        {
+            auto b = bottom.load(std::memory_order_relaxed) - 1;
+            auto a = buf.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto t = top.load(std::memory_order_relaxed);
+            if (t > b) // empty
+            {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return std::nullopt;
+            }
+            auto x = a->get(b);
+            if (t == b) // last one : race the thieves for it
+            {
+                bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom.store(b + 1, std::memory_order_relaxed);
+                if (!won)
+                    return std::nullopt;
+            }
+            return x;
+        }
+
+        // Any thread, takes the oldest element (FIFO)
+        // Returns nothing if empty or if it lost a race, so nothing doesn't always mean empty
+        std::optional<T> steal()
+        {
+            auto t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto b = bottom.load(std::memory_order_acquire);
+            if (t >= b)
+                return std::nullopt;
+            auto h = hazptr::make_hazard_pointer();
+            auto a = h.protect(buf);
+            auto x = a->get(t);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return std::nullopt;
+            return x;
+        }
+
+        // Approximate unless called by the owner with no thieves around
+        std::size_t size() const
+        {
+            auto b = bottom.load(std::memory_order_relaxed);
+            auto t = top.load(std::memory_order_relaxed);
+            return b > t ? static_cast<std::size_t>(b - t) : 0;
+        }
+        bool empty() const { return size() == 0; }
+        std::size_t capacity() const { return static_cast<std::size_t>(buf.load(std::memory_order_relaxed)->capacity()); }
+    };
+}
@@ -0,0 +1,260 @@
+// Work-stealing thread pool over chase_lev_deque, with fork-join parallel_for
+
+// Every worker owns a deque of tasks. Tasks spawned by a worker go to the bottom of its own deque
+// and it pops them back LIFO, so a worker mostly runs what it just split off (hot in its cache)
+// and touches nothing shared. An idle worker steals from the top of a random victim's deque,
+// ie the oldest and usually biggest piece of work.
+// Tasks from threads outside the pool go through an injection queue (faa_array_queue), which
+// workers check before stealing.
+
+// Idle workers spin for a while, then sleep on an atomic counter (C++20 atomic::wait).
+// The sleeper count is bumped before the last look for work and a pusher checks it after
+// publishing its task, both seq_cst, so either the sleeper sees the task or the pusher sees the
+// sleeper and wakes it.
+
+// parallel_for(first, last, grain, f) splits [first, last) in halves down to grain sized leaves.
+// The calling thread takes part : a worker keeps running tasks while it waits, an outside thread
+// steals from the workers. A pending count of indices not yet done tells when it is over.
+// f must not throw (it runs on whatever thread picks the task up).
+
+// The destructor runs everything submitted before returning.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "chase_lev_deque.h"
+#include "../segmented_queue/faa_array_queue.h"
+
+namespace work_stealing
+{
+    // Type erased unit of work, runs (and deletes) itself
+    struct task
+    {
+        void (*run)(task *);
+    };
+
+    class thread_pool
+    {
+        static constexpr unsigned spins_before_sleep = 64;
+
+        struct alignas(64) worker
+        {
+            chase_lev_deque<task *> deque;
+            std::uint64_t rng; // victim selection, xorshift
+        };
+
+        std::vector<std::unique_ptr<worker>> workers;
+        std::vector<std::thread> threads;
+        segmented_queue::faa_array_queue<task *> injected;
+        alignas(64) std::atomic<std::uint32_t> wake_signal{0};
+        std::atomic<unsigned> sleepers{0};
+        std::atomic<bool> stop{false};
+
+        struct current
+        {
+            thread_pool *pool;
+            worker *self;
+        };
+        static current &me()
+        {
+            thread_local current c{};
+            return c;
+        }
+
+        worker *local_worker()
+        {
+            auto &c = me();
+            return c.pool == this ? c.self : nullptr;
+        }
+
+        void wake_one()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepers.load(std::memory_order_relaxed))
+            {
+                wake_signal.fetch_add(1, std::memory_order_release);
+                wake_signal.notify_one();
+            }
+        }
+
+        void push(task *t)
+        {
+            if (auto w = local_worker())
+                w->deque.push(t);
+            else
+                injected.enqueue(t);
+            wake_one();
+        }
+
+        task *steal(std::uint64_t &rng)
+        {
+            auto n = workers.size();
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            auto start = static_cast<std::size_t>(rng % n);
+            for (std::size_t k = 0; k < n; ++k)
+            {
+                auto &victim = *workers[(start + k) % n];
+                if (auto t = victim.deque.steal())
+                    return *t;
+            }
+            return nullptr;
+        }
+
+        // One look everywhere : own deque, injection queue, other workers
+        task *find_task(worker *w, std::uint64_t &rng)
+        {
+            if (w)
+                if (auto t = w->deque.pop())
+                    return *t;
+            if (auto t = injected.dequeue())
+                return *t;
+            return steal(rng);
+        }
+
+        void worker_loop(worker &w)
+        {
+            me() = {this, &w};
+            unsigned idle = 0;
+            while (true)
+            {
+                if (auto t = find_task(&w, w.rng))
+                {
+                    t->run(t);
+                    idle = 0;
+                    continue;
+                }
+                if (++idle < spins_before_sleep)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                // going to sleep : announce it, then take one last look
+                auto signal = wake_signal.load(std::memory_order_acquire);
+                sleepers.fetch_add(1, std::memory_order_seq_cst);
+                if (auto t = find_task(&w, w.rng))
+                {
+                    sleepers.fetch_sub(1, std::memory_order_relaxed);
+                    t->run(t);
+                    idle = 0;
+                    continue;
+                }
+                if (stop.load(std::memory_order_acquire))
+                {
+                    sleepers.fetch_sub(1, std::memory_order_relaxed);
+                    return;
+                }
+                wake_signal.wait(signal, std::memory_order_acquire);
+                sleepers.fetch_sub(1, std::memory_order_relaxed);
+                idle = 0;
+            }
+        }
+
+        template <typename F>
+        struct fn_task : task
+        {
+            F fn;
+            explicit fn_task(F &&f) : task{&execute}, fn{std::move(f)} {}
+            static void execute(task *t)
+            {
+                auto self = static_cast<fn_task *>(t);
+                self->fn();
+                delete self;
+            }
+        };
+
+        // [lo, hi) of a parallel_for : halves itself down to grain, pushing the upper halves
+        template <typename F>
+        struct range_task : task
+        {
+            thread_pool *pool;
+            const F *fn;
+            std::atomic<std::size_t> *pending;
+            std::size_t lo, hi, grain;
+
+            range_task(thread_pool *p, const F *f, std::atomic<std::size_t> *pend, std::size_t l, std::size_t h, std::size_t g)
+                : task{&execute}, pool{p}, fn{f}, pending{pend}, lo{l}, hi{h}, grain{g} {}
+
+            static void execute(task *t)
+            {
+                auto self = static_cast<range_task *>(t);
+                auto lo = self->lo, hi = self->hi;
+                while (hi - lo > self->grain)
+                {
+                    auto mid = lo + (hi - lo) / 2;
+                    self->pool->push(new range_task{self->pool, self->fn, self->pending, mid, hi, self->grain});
+                    hi = mid;
+                }
+                for (auto i = lo; i < hi; ++i)
+                    (*self->fn)(i);
+                // the caller may return as soon as pending hits 0 : touch nothing of its after this
+                auto pending = self->pending;
+                delete self;
+                pending->fetch_sub(hi - lo, std::memory_order_release);
+            }
+        };
+
+    public:
+        explicit thread_pool(unsigned n = std::max(1u, std::thread::hardware_concurrency()))
+        {
+            workers.reserve(n);
+            for (unsigned i = 0; i < n; ++i)
+            {
+                workers.push_back(std::make_unique<worker>());
+                workers.back()->rng = 0x9E3779B97F4A7C15ull * (i + 1);
+            }
+            threads.reserve(n);
+            for (unsigned i = 0; i < n; ++i)
+                threads.emplace_back([this, i]
+                                     { worker_loop(*workers[i]); });
+        }
+        thread_pool(const thread_pool &) = delete;
+        thread_pool &operator=(const thread_pool &) = delete;
+        ~thread_pool()
+        {
+            stop.store(true, std::memory_order_release);
+            wake_signal.fetch_add(1, std::memory_order_release);
+            wake_signal.notify_all();
+            for (auto &t : threads)
+                t.join();
+        }
+
+        std::size_t size() const { return workers.size(); }
+
+        // Fire and forget
+        template <typename F>
+        void submit(F f)
+        {
+            push(new fn_task<F>{std::move(f)});
+        }
+
+        // Calls f(i) for every i in [first, last), grain indices per leaf task, returns when done
+        template <typename F>
+        void parallel_for(std::size_t first, std::size_t last, std::size_t grain, const F &f)
+        {
+            if (first >= last)
+                return;
+            std::atomic<std::size_t> pending{last - first};
+            // run the root here : it pushes its upper halves and works down the leftmost leaf
+            task *root = new range_task<F>{this, &f, &pending, first, last, std::max<std::size_t>(grain, 1)};
+            root->run(root);
+            auto w = local_worker();
+            std::uint64_t rng = reinterpret_cast<std::uintptr_t>(&pending) | 1;
+            while (pending.load(std::memory_order_acquire))
+            {
+                if (auto other = find_task(w, rng))
+                    other->run(other);
+                else
+                    std::this_thread::yield();
+            }
+        }
+    };
+}
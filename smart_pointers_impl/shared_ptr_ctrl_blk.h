@@ -1,83 +1,334 @@
 #pragma once
 #include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Control blocks are type erased with a plain function pointer instead of virtual functions :
+// no vtable, and acquire / release are non-virtual and inlined. The only indirect call left
+// is destroy, made once per block by whoever drops the last reference.
+
+// How the reference count is kept is a policy (template parameter Count of shd_ptr) :
+//   atomic_count      plain atomic count, any thread may copy / drop (default)
+//   nonatomic_count   plain integer, for objects confined to one thread
+//   biased_count      biased reference counting (Choi, Shull, Torrellas, PACT 2018) :
+//                     the creating thread counts with plain increments, others atomically
+
+// Biased counting in brief : the block keeps two counts, `biased` touched only by its owner
+// thread and an atomic `shared` one for everybody else. The object is alive while their sum is.
+// When the owner's count drops to zero it merges (sets the merged flag in shared) and from then
+// on shared alone decides. A ref taken by the owner may be dropped by another thread, driving
+// shared negative while biased stays up : that thread then queues the block on the owner's
+// thread record (taking a ref for the queue) and the owner merges it on its next release
+// (or merge_queued()).
+// Queues of exited threads are drained by whoever queues onto them, or by the next thread
+// adopting the record. biased shd_ptrs must not be released from static destructors
+// (the thread's record handle is gone by then).
 
 namespace roopam
 {
-    struct ctrl_blk_base
+    struct atomic_count
     {
         std::atomic<int64_t> ref_cnt{1};
-        void acquire_shared()
+        void acquire()
         {
             ref_cnt.fetch_add(1, std::memory_order_relaxed);
         }
-        auto decrement()
+        // true if that was the last reference
+        bool release()
+        {
+            // sole owner : no one else can copy it meanwhile (no weak refs here), skip the RMW
+            return ref_cnt.load(std::memory_order_acquire) == 1 || ref_cnt.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+    };
+
+    struct nonatomic_count
+    {
+        int64_t ref_cnt{1};
+        void acquire() { ++ref_cnt; }
+        bool release() { return --ref_cnt == 0; }
+    };
+
+    class biased_count;
+
+    namespace brc
+    {
+        // One per thread, reused after the thread exits (never freed before the program ends)
+        struct thread_rec
+        {
+            std::atomic<biased_count *> queue{nullptr}; // blocks waiting for their owner to merge
+            std::atomic<bool> in_use{true};
+            bool draining{false};
+            thread_rec *next{};
+        };
+
+        struct registry
+        {
+            std::atomic<thread_rec *> recs{nullptr};
+            ~registry()
+            {
+                for (auto r = recs.exchange(nullptr); r;)
+                    delete std::exchange(r, r->next);
+            }
+        };
+        inline registry &reg()
+        {
+            static registry r;
+            return r;
+        }
+
+        void drain(thread_rec *rec); // needs ctrl_blk_base, defined below it
+
+        // Drains rec's queue if its thread is gone, see thread_handle
+        inline void drain_orphaned(thread_rec *rec)
+        {
+            bool expected = false;
+            while (rec->queue.load() && rec->in_use.compare_exchange_strong(expected, true))
+            {
+                drain(rec);
+                rec->in_use.store(false);
+                expected = false;
+            }
+        }
+
+        inline thread_rec *acquire_rec()
+        {
+            auto &recs = reg().recs;
+            for (auto r = recs.load(std::memory_order_acquire); r; r = r->next)
+            {
+                bool expected = false;
+                if (!r->in_use.load(std::memory_order_relaxed) && r->in_use.compare_exchange_strong(expected, true))
+                    return r;
+            }
+            auto r = new thread_rec;
+            auto h = recs.load(std::memory_order_relaxed);
+            do
+            {
+                r->next = h;
+            } while (!recs.compare_exchange_weak(h, r, std::memory_order_release, std::memory_order_relaxed));
+            return r;
+        }
+
+        struct thread_handle
+        {
+            thread_rec *rec;
+            thread_handle() : rec{acquire_rec()}
+            {
+                if (rec->queue.load()) // adopted from an exited thread
+                    drain(rec);
+            }
+            ~thread_handle()
+            {
+                drain(rec);
+                // release, then look again : a push racing with the release either sees
+                // in_use == false and drains itself, or is seen here (both seq_cst)
+                rec->in_use.store(false);
+                drain_orphaned(rec);
+            }
+        };
+
+        inline thread_rec *self()
+        {
+            thread_local thread_rec *rec = nullptr; // trivially initialized : no TLS init guard on the fast path
+            if (rec) [[likely]]
+                return rec;
+            thread_local thread_handle h;
+            return rec = h.rec;
+        }
+
+        inline void push(thread_rec *rec, biased_count *b);
+    }
+
+    class biased_count
+    {
+        // shared : count in units of `one`, flags in the low bits
+        static constexpr int64_t merged = 1; // owner let go, shared holds the whole count
+        static constexpr int64_t queued = 2; // waiting in the owner's queue (which holds one ref)
+        static constexpr int64_t one = 4;
+        static int64_t count(int64_t s) { return s >> 2; } // may be negative
+
+        brc::thread_rec *owner{brc::self()};
+        int64_t biased{1};         // owner only
+        bool owner_merged{false}; // owner only
+        std::atomic<int64_t> shared{0};
+        biased_count *next_queued{};
+
+        friend void brc::drain(brc::thread_rec *);
+        friend void brc::push(brc::thread_rec *, biased_count *);
+
+    public:
+        void acquire()
+        {
+            if (owner == brc::self() && !owner_merged)
+                ++biased;
+            else
+                shared.fetch_add(one, std::memory_order_relaxed);
+        }
+
+        // true if that was the last reference
+        bool release()
+        {
+            auto me = brc::self();
+            if (owner == me)
+            {
+                if (me->queue.load(std::memory_order_relaxed)) // may merge this very block
+                    brc::drain(me);
+                if (!owner_merged)
+                {
+                    if (--biased > 0)
+                        return false;
+                    owner_merged = true;
+                    return count(shared.fetch_add(merged, std::memory_order_acq_rel)) == 0;
+                }
+            }
+            auto s = shared.fetch_sub(one, std::memory_order_acq_rel) - one;
+            if (s & merged)
+                return count(s) == 0;
+            // not merged : only the owner may free it. If we went negative the owner's count holds
+            // refs that are gone, ask the owner to merge
+            while (count(s) < 0 && !(s & (queued | merged)))
+            {
+                if (shared.compare_exchange_weak(s, (s | queued) + one, std::memory_order_acq_rel))
+                {
+                    brc::push(owner, this);
+                    break;
+                }
+            }
+            return false;
+        }
+    };
+
+    inline void brc::push(thread_rec *rec, biased_count *b)
+    {
+        auto h = rec->queue.load(std::memory_order_relaxed);
+        do
+        {
+            b->next_queued = h;
+        } while (!rec->queue.compare_exchange_weak(h, b, std::memory_order_release, std::memory_order_relaxed));
+        if (!rec->in_use.load())
+            drain_orphaned(rec);
+    }
+
+    template <typename Count>
+    struct ctrl_blk_base : Count
+    {
+        void (*destroy)(ctrl_blk_base *) noexcept; // destroys the object and frees the block
+
+        explicit ctrl_blk_base(void (*d)(ctrl_blk_base *) noexcept) : destroy{d} {}
+        void acquire_shared()
+        {
+            Count::acquire();
+        }
+        void release_shared()
         {
-            return ref_cnt.fetch_sub(1, std::memory_order_acq_rel);
+            if (Count::release())
+                destroy(this);
         }
-        virtual void release_shared() = 0;
-        virtual ~ctrl_blk_base() = default;
     };
 
+    // Merges the queued blocks : adds the owner's count to shared and drops the queue's ref
+    // Only by the thread holding rec
+    inline void brc::drain(thread_rec *rec)
+    {
+        if (rec->draining) // destroying a block released more refs : the loop below picks them up
+            return;
+        rec->draining = true;
+        while (auto b = rec->queue.exchange(nullptr, std::memory_order_acquire))
+        {
+            while (b)
+            {
+                auto next = b->next_queued;
+                auto add = b->owner_merged ? 0 : b->biased * biased_count::one + biased_count::merged;
+                b->owner_merged = true;
+                b->biased = 0;
+                auto s = b->shared.fetch_add(add - biased_count::one, std::memory_order_acq_rel) + add - biased_count::one;
+                if (biased_count::count(s) == 0)
+                {
+                    auto cb = static_cast<ctrl_blk_base<biased_count> *>(b);
+                    cb->destroy(cb);
+                }
+                b = next;
+            }
+        }
+        rec->draining = false;
+    }
+
+    // Merges blocks other threads queued for the calling thread now instead of at its next
+    // biased release, eg at the end of a batch of work
+    inline void merge_queued()
+    {
+        brc::drain(brc::self());
+    }
+
     // Used when creating shared_ptr from raw pointer
     // Control block having pointer to the heap allocated object elsewhere
     // Need to delete both object and ctrl block when ref_cnt becomes zero
-    template <typename T>
-    struct ctrl_blk : ctrl_blk_base
+    // T is the type passed in (maybe derived from shd_ptr's type), so the right destructor runs
+    template <typename T, typename Count = atomic_count>
+    struct ctrl_blk : ctrl_blk_base<Count>
     {
         T *data;
-        explicit ctrl_blk(T *p) : ctrl_blk_base{}, data(p) {}
-        void release_shared() override
+        explicit ctrl_blk(T *p) : ctrl_blk_base<Count>{&destroy_blk}, data(p) {}
+        static void destroy_blk(ctrl_blk_base<Count> *b) noexcept
         {
-            if (decrement() == 1)
-            {
-                delete data;
-                delete this;
-            }
+            auto self = static_cast<ctrl_blk *>(b);
+            delete self->data;
+            delete self;
         }
     };
 
-    // Used when shared_ptr created from make_shared
+    // Used when shared_ptr created from make_shared / allocate_shared
     // Standard optimization done by most libraries :
     // Allocate the controlled object with the ctrl block in the same heap allocation
     // One heap allocation instead of two
     // Thus make_shared is generally more optimized than shared_ptr from new
     // No need of pointer inside ctrl block
     // Just destroy this heap object when ref_cnt becomes zero
-    template <typename T>
-    struct ctrl_blk_with_storage : ctrl_blk_base
+    // The block itself comes from Alloc (rebound), which it keeps a copy of to give the memory back
+    // ([[no_unique_address]] : stateless allocators like std::allocator take no space)
+    template <typename T, typename Alloc = std::allocator<T>, typename Count = atomic_count>
+    struct ctrl_blk_with_storage : ctrl_blk_base<Count>
     {
-        T in_place{};
+        using blk_alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<ctrl_blk_with_storage>;
+        using blk_traits = std::allocator_traits<blk_alloc>;
+
+        [[no_unique_address]] blk_alloc alloc;
+        T in_place;
 
         // Perfect forwarding of args to ctor of T
         template <typename... Args>
-        explicit ctrl_blk_with_storage(Args &&...args) : ctrl_blk_base{}, in_place{std::forward<Args>(args)...} {}
+        explicit ctrl_blk_with_storage(const Alloc &a, Args &&...args)
+            : ctrl_blk_base<Count>{&destroy_blk}, alloc{a}, in_place(std::forward<Args>(args)...) {}
 
         T *get()
         {
             return &in_place;
         }
-        void release_shared() override
+        static void destroy_blk(ctrl_blk_base<Count> *b) noexcept
         {
-            if (decrement() == 1)
-            {
-                delete this;
-            }
+            auto self = static_cast<ctrl_blk_with_storage *>(b);
+            blk_alloc a{std::move(self->alloc)};
+            self->~ctrl_blk_with_storage();
+            blk_traits::deallocate(a, self, 1);
         }
     };
 
-    template <typename T>
+    // Count : reference counting policy, see top of file
+    template <typename T, typename Count = atomic_count>
     class shd_ptr
     {
         T *data{};
-        ctrl_blk_base *control_block{};
+        ctrl_blk_base<Count> *control_block{};
 
-        shd_ptr(T *p, ctrl_blk_base *cb) : data{p}, control_block{cb} {}
-
-        shd_ptr(ctrl_blk_with_storage<T> *cb) : shd_ptr{cb->get(), cb} {}
+        shd_ptr(T *p, ctrl_blk_base<Count> *cb) : data{p}, control_block{cb} {}
 
     public:
         shd_ptr() = default;
-        shd_ptr(T *p) : shd_ptr{p, new ctrl_blk<T>{p}} {}
+        template <typename U>
+            requires std::is_convertible_v<U *, T *>
+        shd_ptr(U *p) : shd_ptr{p, new ctrl_blk<U, Count>{p}} {}
         shd_ptr(const shd_ptr &other) : data{other.data}, control_block{other.control_block}
         {
             if (control_block)
@@ -124,14 +375,32 @@ namespace roopam
             return data;
         }
 
-        template <typename U, typename... Args>
-        friend shd_ptr<U> make_shared(Args &&...args);
+        template <typename U, typename C, typename Alloc, typename... Args>
+        friend shd_ptr<U, C> allocate_shared(const Alloc &alloc, Args &&...args);
     };
 
-    template <typename T, typename... Args>
-    shd_ptr<T> make_shared(Args &&...args)
+    // Object and ctrl block in one allocation from alloc (eg an arena or a pool allocator)
+    template <typename T, typename Count = atomic_count, typename Alloc, typename... Args>
+    shd_ptr<T, Count> allocate_shared(const Alloc &alloc, Args &&...args)
+    {
+        using blk = ctrl_blk_with_storage<T, Alloc, Count>;
+        typename blk::blk_alloc a{alloc};
+        auto *cb = blk::blk_traits::allocate(a, 1);
+        try
+        {
+            ::new (static_cast<void *>(cb)) blk{alloc, std::forward<Args>(args)...};
+        }
+        catch (...)
+        {
+            blk::blk_traits::deallocate(a, cb, 1);
+            throw;
+        }
+        return shd_ptr<T, Count>(cb->get(), cb);
+    }
+
+    template <typename T, typename Count = atomic_count, typename... Args>
+    shd_ptr<T, Count> make_shared(Args &&...args)
     {
-        auto *cb = new ctrl_blk_with_storage<T>{std::forward<Args>(args)...};
-        return shd_ptr<T>(cb);
+        return roopam::allocate_shared<T, Count>(std::allocator<T>{}, std::forward<Args>(args)...);
     }
 }
\ No newline at end of file